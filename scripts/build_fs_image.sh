@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Builds the FAT32 disk image attached as the secondary ATA bus master.
+#
+# The image carries an MBR with a single FAT32 (LBA) partition starting at
+# 1MiB, the kernel ELF is copied in so there is real data to read back.
+
+set -e
+set -o pipefail
+
+image=./bin/fs-image.bin
+image_mib=64
+part_start=2048
+
+rm -f ${image}
+dd if=/dev/zero of=${image} bs=1M count=${image_mib} status=none
+
+echo "start=${part_start}, type=c" | sfdisk --quiet ${image}
+
+# mkfs.fat takes the filesystem size in 1KiB blocks.
+part_kib=$(((image_mib * 1024) - (part_start / 2)))
+mkfs.fat -F 32 -s 1 -n OS --offset ${part_start} ${image} ${part_kib}
+
+mcopy -i ${image}@@$((part_start * 512)) ./src/kernel/kernel ::KERNEL.ELF
+
+echo "filesystem image is ${image_mib} MiB"
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+
+# Builds the boot disk image:
+#
+#   LBA 0          boot sector, its stage2_sectors field patched
+#   LBA 1          second stage loader
+#   LBA 1 + n      payload header, one sector
+#   ...            one LZ4 block per loadable ELF segment, sector aligned
+#
+# Only PT_LOAD segments of the kernel ELF are stored, compressed, and the BSS
+# part of a segment (p_memsz beyond p_filesz) is zeroed by the loader rather
+# than stored. Every block comes with the offset past its destination
+# address at which the loader reads it, so it decompresses in place.
+
+import os
+import struct
+import sys
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import lz4  # noqa: E402
+
+SECTOR = 512
+STAGE2_LBA = 1
+STAGE2_SECTORS_OFFSET = 2
+PAYLOAD_MAGIC = 0x345A4C4B  # "KLZ4"
+PAYLOAD_MAX_SEGMENTS = 8
+PT_LOAD = 1
+
+BOOT = "./bin/boot.bin"
+STAGE2 = "./bin/stage2.bin"
+KERNEL = "./src/kernel/kernel"
+IMAGE = "./bin/os-image.bin"
+
+
+def sectors(size):
+    return (size + SECTOR - 1) // SECTOR
+
+
+def pad(data):
+    return data + b"\0" * (sectors(len(data)) * SECTOR - len(data))
+
+
+def load_segments(path):
+    elf = open(path, "rb").read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1:
+        sys.exit("%s is not a 32 bit ELF" % path)
+    entry, phoff = struct.unpack_from("<II", elf, 0x18)
+    phentsize, phnum = struct.unpack_from("<HH", elf, 0x2A)
+
+    segments = []
+    entry_phys = None
+    for i in range(phnum):
+        (p_type, offset, vaddr, paddr, filesz, memsz, _,
+         _) = struct.unpack_from("<8I", elf, phoff + i * phentsize)
+        if p_type != PT_LOAD or not memsz:
+            continue
+        segments.append((paddr, elf[offset:offset + filesz], memsz))
+        # the loader runs without paging, jump to the physical entry point.
+        if vaddr <= entry < vaddr + memsz:
+            entry_phys = entry - vaddr + paddr
+    if entry_phys is None:
+        sys.exit("entry point 0x%x is not in a loadable segment" % entry)
+    if len(segments) > PAYLOAD_MAX_SEGMENTS:
+        sys.exit("too many loadable segments (%d)" % len(segments))
+    return entry_phys, sorted(segments)
+
+
+def main():
+    boot = bytearray(open(BOOT, "rb").read())
+    stage2 = pad(open(STAGE2, "rb").read())
+    entry, segments = load_segments(KERNEL)
+
+    stage2_sectors = len(stage2) // SECTOR
+    struct.pack_into("<I", boot, STAGE2_SECTORS_OFFSET, stage2_sectors)
+
+    header = struct.pack("<III", PAYLOAD_MAGIC, entry, len(segments))
+    blocks = b""
+    lba = STAGE2_LBA + stage2_sectors + 1
+    raw = stored = 0
+    for paddr, data, memsz in segments:
+        block = lz4.compress(data) if data else b""
+        # the block is read to paddr + load_offset. A block which runs past
+        # its segment only overlaps memory the loader writes afterwards.
+        load_offset = lz4.inplace_offset(block)
+        block_sectors = sectors(len(block))
+        header += struct.pack("<7I", paddr, len(data), memsz,
+                              lba if block else 0, block_sectors,
+                              len(block), load_offset)
+        blocks += pad(block)
+        lba += block_sectors
+        raw += len(data)
+        stored += block_sectors * SECTOR
+        print("segment 0x%08x: %d bytes (%d in memory) -> %d compressed, "
+              "read at +%d" % (paddr, len(data), memsz, len(block),
+                               load_offset))
+
+    if len(header) > SECTOR:
+        sys.exit("payload header exceeds one sector")
+
+    with open(IMAGE, "wb") as f:
+        f.write(boot)
+        f.write(stage2)
+        f.write(pad(header))
+        f.write(blocks)
+
+    print("kernel payload %d bytes, %d on disk (%d%%)" %
+          (raw, stored, 100 * stored // max(raw, 1)))
+
+
+if __name__ == "__main__":
+    main()
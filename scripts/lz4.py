@@ -0,0 +1,128 @@
+# LZ4 block format compressor, plus the in-place decompression analysis the
+# second stage boot loader relies on.
+#
+# Only the raw block format is produced (no frame header or checksums). The
+# end of block rules of the format are honoured: the last match starts at
+# least 12 bytes before the end and the last 5 bytes are literals.
+
+MIN_MATCH = 4
+MF_LIMIT = 12
+LAST_LITERALS = 5
+MAX_OFFSET = 65535
+
+
+def _length(out, n):
+    # lengths of 15 and above continue in extra bytes of 255.
+    n -= 15
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _sequence(out, literals, offset, match_len):
+    lit = len(literals)
+    token = min(lit, 15) << 4
+    if offset:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit >= 15:
+        _length(out, lit)
+    out += literals
+    if offset:
+        out += offset.to_bytes(2, "little")
+        if match_len - MIN_MATCH >= 15:
+            _length(out, match_len - MIN_MATCH)
+
+
+def compress(data):
+    """Compress `data` into a single LZ4 block, greedy with a hash table of
+    the last position of every 4 byte sequence."""
+    n = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    limit = n - MF_LIMIT
+    while i < limit:
+        key = data[i:i + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = i
+        if candidate is None or i - candidate > MAX_OFFSET:
+            i += 1
+            continue
+
+        length = MIN_MATCH
+        end = n - LAST_LITERALS - i
+        while length < end and data[candidate + length] == data[i + length]:
+            length += 1
+
+        _sequence(out, data[anchor:i], i - candidate, length)
+        # index inside the match as well, sparsely, to keep it fast.
+        for j in range(i + 1, i + length, 8):
+            if j < limit:
+                table[data[j:j + MIN_MATCH]] = j
+        i += length
+        anchor = i
+
+    _sequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def _sequences(block):
+    """Yield (literal_start, literal_len, offset, match_len, next_read) for
+    every sequence of a block, offsets into `block`."""
+    i = 0
+    n = len(block)
+    while i < n:
+        token = block[i]
+        i += 1
+        lit = token >> 4
+        if lit == 15:
+            while True:
+                b = block[i]
+                i += 1
+                lit += b
+                if b != 255:
+                    break
+        start = i
+        i += lit
+        if i >= n:
+            yield start, lit, 0, 0, i
+            return
+        offset = block[i] | block[i + 1] << 8
+        i += 2
+        match = token & 0xF
+        if match == 15:
+            while True:
+                b = block[i]
+                i += 1
+                match += b
+                if b != 255:
+                    break
+        yield start, lit, offset, match + MIN_MATCH, i
+
+
+def decompress(block):
+    out = bytearray()
+    for start, lit, offset, match, _ in _sequences(block):
+        out += block[start:start + lit]
+        for _ in range(match):
+            out.append(out[-offset])
+    return bytes(out)
+
+
+def inplace_offset(block):
+    """Smallest offset from the start of the output at which `block` can be
+    placed so that decompressing it forward into the same buffer never
+    overwrites compressed bytes which are still to be read.
+
+    Literal bytes are read before they are written, so a sequence is safe if
+    its output, once complete, ends at or before the first byte of the next
+    sequence."""
+    written = 0
+    worst = 0
+    for _, lit, _, match, next_read in _sequences(block):
+        written += lit + match
+        worst = max(worst, written - next_read)
+    return worst
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+
+# Symbolizes the samples dumped over serial by the kernel profiler.
+#
+# Reads the serial log (or stdin), finds the block between "profile: begin"
+# and "profile: end" and resolves every address against the kernel ELF's
+# symbol table. Prints a flat profile by default, or flamegraph compatible
+# folded stacks ("outer;...;inner count" per line) with --folded.
+#
+#   make run PROFILE=1 | tee serial.log
+#   ./scripts/profile.py serial.log
+#   ./scripts/profile.py --folded serial.log | flamegraph.pl > profile.svg
+
+import argparse
+import bisect
+import collections
+import shutil
+import subprocess
+import sys
+
+
+def load_symbols(kernel):
+    nm = shutil.which("x86_64-linux-gnu-nm") or "nm"
+    out = subprocess.run([nm, "-n", "--defined-only", kernel],
+                         check=True, capture_output=True, text=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 3 or parts[1] not in "tTwW":
+            continue
+        addrs.append(int(parts[0], 16))
+        names.append(parts[2])
+    return addrs, names
+
+
+def symbolize(addrs, names, pc):
+    i = bisect.bisect_right(addrs, pc) - 1
+    if i < 0:
+        return "0x%08x" % pc
+    return names[i]
+
+
+def read_samples(lines):
+    samples, header, inside = [], "", False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("profile: begin"):
+            samples, header, inside = [], line, True
+        elif line.startswith("profile: end"):
+            inside = False
+        elif inside and line.startswith("s "):
+            samples.append([int(pc, 16) for pc in line.split()[1:]])
+    return header, samples
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--kernel", default="./src/kernel/kernel")
+    parser.add_argument("--folded", action="store_true",
+                        help="print folded stacks instead of a flat profile")
+    parser.add_argument("--top", type=int, default=30)
+    parser.add_argument("log", nargs="?", help="serial log, stdin if omitted")
+    args = parser.parse_args()
+
+    with (open(args.log, errors="replace") if args.log else sys.stdin) as f:
+        header, samples = read_samples(f)
+    if not samples:
+        sys.exit("no profile samples found")
+
+    addrs, names = load_symbols(args.kernel)
+
+    stacks = []
+    for pcs in samples:
+        # return addresses point after the call, look up the call itself.
+        frames = [symbolize(addrs, names, pcs[0])]
+        frames += [symbolize(addrs, names, pc - 1) for pc in pcs[1:]]
+        stacks.append(frames)
+
+    if args.folded:
+        folded = collections.Counter(";".join(reversed(s)) for s in stacks)
+        for stack, count in sorted(folded.items()):
+            print("%s %d" % (stack, count))
+        return
+
+    self_counts = collections.Counter(s[0] for s in stacks)
+    total_counts = collections.Counter()
+    for s in stacks:
+        # count recursive functions once per sample.
+        total_counts.update(set(s))
+
+    n = len(stacks)
+    print(header)
+    print("%8s %7s %8s %7s  %s" % ("self", "self%", "total", "total%",
+                                   "function"))
+    for name, count in self_counts.most_common(args.top):
+        total = total_counts[name]
+        print("%8d %6.2f%% %8d %6.2f%%  %s" %
+              (count, 100.0 * count / n, total, 100.0 * total / n, name))
+
+
+if __name__ == "__main__":
+    main()
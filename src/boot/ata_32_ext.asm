@@ -22,29 +22,20 @@ B1_COMMAND equ 0x1F7
 ; Master drive with LBA mode selected
 MASTER_DRIVE equ 0x40
 
-; LBA address kernel begins at (second sector)
-KERNEL_LBA equ 0x1
-; Load address of kernel
-KERNEL_LOAD_ADDR equ 0x100000
-
-global ata_load_kernel
-; Loads our kernel using ATA READ SECTOR EXT command.
+global ata_read_sectors
+; Reads sectors from the primary master using ATA READ SECTOR EXT command.
 ; EXT reads allow for 16 bit sector counts and 48 bit LBA addresses.
 ;
-; persisent registers
-; %EBP - 32-bit total sectors to load
+; persisent registers, set by the caller
+; %EBP - 32-bit total sectors to load, must not be 0
 ; %ESI - LBA48 address to start read from (limited to 32 bits).
-; %EDI - 32-bit memory address to load kernel too, incremented by rep insw
+; %EDI - 32-bit memory address to load sectors to, incremented by rep insw
 ;
 ; temporary registers
 ; %EDX/DX - used primarily for in/out ports	 / scratch register
 ; %EAX/AL - used primarily for in/out values / scratch register
 ; %EBX/BL - used for delay loop counter / per-read-command sector count
-ata_load_kernel:
-	mov ebp, [kernel_sectors]
-	mov esi, KERNEL_LBA
-	mov edi, KERNEL_LOAD_ADDR
-
+ata_read_sectors:
 	; configure drive and LBA addressing mode
 	mov dx, B1_DRIVE_SELECT
 	mov al, MASTER_DRIVE
@@ -100,7 +91,7 @@ ata_load_kernel:
 	; READ SECTOR EXT can handle a 16-bit sector count (65536 full sectors, where
 	; 0 is provided to read 65536 sectors)
 	;
-	; If provided kernel sectors < 65536, we write the kernel sectors directly
+	; If the remaining sectors are < 65536, we write the sector count directly
 	; to the sector count register.
 	;
 	; If sectors >= 65536, we write 0 to the sector count register to read
@@ -157,9 +148,9 @@ ata_load_kernel:
 
 	; start the copy
 	mov dx, B1_DATA	; insw port
-	mov cx, 256		; rep counter, (512 bytes / 2 byte words)
+	mov ecx, 256	; rep counter, (512 bytes / 2 byte words)
 	rep insw		; start copy, will repeat until cx is 0, increments edi
-					; (kernel load address) each time.
+					; (load address) each time.
 
 	inc esi			; Increment LBA
 	dec ebp			; Decrement total sector count
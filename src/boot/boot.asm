@@ -1,14 +1,17 @@
 ; We start our x86 machines in 16 bit real mode
 BITS 16
 
+%include "src/boot/boot.inc"
+
 section .text.bootloader
 
 loader_start:
 jmp start;
 
-; patched during compilation process, once we know the number of sectors our
-; kernel image takes up, used in ata_32_ext.asm.
-kernel_sectors:
+; patched by scripts/build_image.py with the number of sectors the second
+; stage takes up (STAGE2_SECTORS_ADDR), the second stage then loads the
+; kernel described by the payload header that follows it.
+stage2_sectors:
 dd 0x00000000
 
 ; setup global descriptor table, flat memory model.
@@ -81,22 +84,25 @@ load_kernel_32:
 	or al, 2
 	out 0x92, al
 
-	; if kernel_sectors is zero, just halt the system, our bootloader was never
-	; patched with the number of kernel sectors to load.
-	cmp byte [kernel_sectors], 0
-	je $
+	; if stage2_sectors is zero, just halt the system, our bootloader was never
+	; patched with the number of second stage sectors to load.
+	mov ebp, [stage2_sectors]
+	test ebp, ebp
+	jz $
 
-	call ata_load_kernel
+	mov esi, STAGE2_LBA
+	mov edi, STAGE2_LOAD_ADDR
+	call ata_read_sectors
 
-global jump_kernel
-jump_kernel:
+global jump_stage2
+jump_stage2:
 	; must far-jump (segment:address) for assembler to produce a jmp to an
 	; absolute address.
-	jmp CODE_SEGMENT:KERNEL_LOAD_ADDR
+	jmp CODE_SEGMENT:STAGE2_LOAD_ADDR
 
 	jmp $
 
-; include ATA routine for reading kernel sectors and loading to memory.
+; include ATA routine for reading sectors to memory.
 %include "src/boot/ata_32_ext.asm"
 
 ; ensure our bootloader does not exceed 512 bytes
@@ -0,0 +1,156 @@
+; Second stage boot loader, loaded to STAGE2_LOAD_ADDR by boot.asm and entered
+; in 32 bit protected mode with flat segments and the a20 gate enabled.
+;
+; Reads the payload header following this stage on disk and loads the kernel
+; segment by segment: each LZ4 block is read behind its destination, at the
+; offset scripts/build_image.py found to be safe, decompressed in place and
+; the segment's BSS zeroed. Load statistics are left at BOOT_INFO_ADDR for
+; the kernel to report.
+[BITS 32]
+
+%include "src/boot/boot.inc"
+
+section .text.stage2
+
+global stage2_start
+stage2_start:
+	mov esp, STAGE2_STACK
+	cld
+
+	rdtsc
+	mov [BOOT_INFO_ADDR + BI_TSC_START], eax
+	mov [BOOT_INFO_ADDR + BI_TSC_START + 4], edx
+	xor eax, eax
+	mov [BOOT_INFO_ADDR + BI_DISK_BYTES], eax
+	mov [BOOT_INFO_ADDR + BI_IMAGE_BYTES], eax
+	mov [BOOT_INFO_ADDR + BI_MEMORY_BYTES], eax
+
+	; the payload header is the sector right after this stage.
+	mov esi, [STAGE2_SECTORS_ADDR]
+	add esi, STAGE2_LBA
+	mov edi, PAYLOAD_HEADER_ADDR
+	mov ebp, 1
+	call ata_read_sectors
+
+	cmp dword [PAYLOAD_HEADER_ADDR + PH_MAGIC], PAYLOAD_MAGIC
+	jne abort
+
+	mov ecx, [PAYLOAD_HEADER_ADDR + PH_SEGMENT_COUNT]
+	mov ebx, PAYLOAD_HEADER_ADDR + PH_SEGMENTS
+
+.segment:
+	test ecx, ecx
+	jz .done
+	push ecx
+	push ebx
+
+	; a segment made of BSS only has no block to read.
+	mov ebp, [ebx + SEG_SECTORS]
+	test ebp, ebp
+	jz .decompress
+	mov eax, ebp
+	shl eax, 9
+	add [BOOT_INFO_ADDR + BI_DISK_BYTES], eax
+	mov esi, [ebx + SEG_LBA]
+	mov edi, [ebx + SEG_PADDR]
+	add edi, [ebx + SEG_LOAD_OFFSET]
+	call ata_read_sectors
+	mov ebx, [esp]
+
+.decompress:
+	mov esi, [ebx + SEG_PADDR]
+	add esi, [ebx + SEG_LOAD_OFFSET]
+	mov ebp, esi
+	add ebp, [ebx + SEG_COMPRESSED_SIZE]
+	mov edi, [ebx + SEG_PADDR]
+	call lz4_decompress
+
+	; the block must decompress to exactly the segment's file size.
+	mov eax, [ebx + SEG_PADDR]
+	add eax, [ebx + SEG_FILESZ]
+	cmp edi, eax
+	jne abort
+
+	; zero the rest of the segment in memory, edi is at its file end.
+	mov ecx, [ebx + SEG_MEMSZ]
+	sub ecx, [ebx + SEG_FILESZ]
+	xor eax, eax
+	rep stosb
+
+	mov eax, [ebx + SEG_FILESZ]
+	add [BOOT_INFO_ADDR + BI_IMAGE_BYTES], eax
+	mov eax, [ebx + SEG_MEMSZ]
+	add [BOOT_INFO_ADDR + BI_MEMORY_BYTES], eax
+
+	pop ebx
+	pop ecx
+	add ebx, SEG_SIZE
+	dec ecx
+	jmp .segment
+
+.done:
+	rdtsc
+	mov [BOOT_INFO_ADDR + BI_TSC_END], eax
+	mov [BOOT_INFO_ADDR + BI_TSC_END + 4], edx
+	mov dword [BOOT_INFO_ADDR + BI_MAGIC], BOOT_INFO_MAGIC
+
+	mov eax, [PAYLOAD_HEADER_ADDR + PH_ENTRY]
+	jmp eax
+
+; Decompresses an LZ4 block.
+;
+; %ESI - block start, advanced to the block end
+; %EBP - block end
+; %EDI - destination, advanced to the end of the decompressed data
+;
+; %EAX, %ECX, %EDX are clobbered. Copies run forward a byte at a time with rep
+; movsb, which is what both overlapping matches and in place decompression
+; (destination below the unread input) need.
+lz4_decompress:
+.sequence:
+	cmp esi, ebp
+	jae .end
+	; token, literal length in the high nibble, match length - 4 in the low.
+	movzx edx, byte [esi]
+	inc esi
+	mov eax, edx
+	shr eax, 4
+	cmp eax, 15
+	jne .literals
+.literal_length:
+	movzx ecx, byte [esi]
+	inc esi
+	add eax, ecx
+	cmp ecx, 255
+	je .literal_length
+.literals:
+	mov ecx, eax
+	rep movsb
+	; the last sequence carries literals only.
+	cmp esi, ebp
+	jae .end
+
+	movzx eax, word [esi]
+	add esi, 2
+	and edx, 0xF
+	cmp edx, 15
+	jne .match
+.match_length:
+	movzx ecx, byte [esi]
+	inc esi
+	add edx, ecx
+	cmp ecx, 255
+	je .match_length
+.match:
+	lea ecx, [edx + 4]
+	push esi
+	mov esi, edi
+	sub esi, eax
+	rep movsb
+	pop esi
+	jmp .sequence
+.end:
+	ret
+
+; include ATA routine for reading sectors to memory.
+%include "src/boot/ata_32_ext.asm"
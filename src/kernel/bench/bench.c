@@ -0,0 +1,447 @@
+#include "bench.h"
+
+#include <stdint.h>
+
+#include "../checksum/checksum.h"
+#include "../cpu/cpu.h"
+#include "../cpu/fpu.h"
+#include "../drivers/ata/ata.h"
+#include "../drivers/blk/blk.h"
+#include "../drivers/serial/serial.h"
+#include "../idle/idle.h"
+#include "../idt.h"
+#include "../io/io.h"
+#include "../memory/heap.h"
+#include "../memory/memory.h"
+#include "../memory/paging.h"
+#include "../proc/process.h"
+#include "../syscall/syscall.h"
+#include "../timer/timer.h"
+
+uint64_t bench_tsc_khz;
+
+void bench_report(const char *name, uint32_t size, uint32_t ops,
+                  uint64_t min, uint64_t total, int throughput) {
+    uint64_t avg = cpu_div64(total, BENCH_ROUNDS);
+
+    serial_write_str("bench: name=");
+    serial_write_str(name);
+    serial_write_str(" size=");
+    serial_write_dec(size);
+    serial_write_str(" ops=");
+    serial_write_dec(ops);
+    serial_write_str(" cycles_min=");
+    serial_write_dec(cpu_div64(min, ops));
+    serial_write_str(" cycles_avg=");
+    serial_write_dec(cpu_div64(avg, ops));
+    if (throughput) {
+        // bytes per cycle * cycles per millisecond = bytes per millisecond,
+        // which is KiB/s scaled by 1000/1024.
+        uint64_t bytes = (uint64_t)size * ops;
+        serial_write_str(" kib_per_sec=");
+        serial_write_dec(cpu_div64(bytes * bench_tsc_khz * 1000, avg * 1024));
+    }
+    serial_write_str("\n");
+}
+
+// Time BENCH_ROUNDS rounds of `ops` calls to `fn`, returning the fastest
+// round in `min` and the sum of all rounds in `total`. Returns 0 as soon as
+// `fn` fails.
+int bench_measure(int (*fn)(uint32_t i, void *ctx), void *ctx, uint32_t ops,
+                  uint64_t *min, uint64_t *total) {
+    *min = ~0ULL;
+    *total = 0;
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t start = cpu_rdtsc();
+        for (uint32_t i = 0; i < ops; i++) {
+            if (!fn(i, ctx)) {
+                return 0;
+            }
+        }
+        uint64_t cycles = cpu_rdtsc() - start;
+        *total += cycles;
+        if (cycles < *min) {
+            *min = cycles;
+        }
+    }
+    return 1;
+}
+
+typedef struct bench_buffer {
+    uint8_t *data;
+    uint32_t size;
+} bench_buffer;
+
+int bench_memset_op(uint32_t i, void *ctx) {
+    bench_buffer *b = ctx;
+    memset(b->data, i, b->size);
+    return 1;
+}
+
+int bench_memset() {
+    const uint32_t sizes[] = {64, 4096, 65536, 1 << 20};
+    uint8_t *data = heap_malloc(1 << 20);
+    if (!data) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_buffer b = {data, sizes[i]};
+        // about 4MiB per round.
+        uint32_t ops = (4 << 20) / sizes[i];
+        uint64_t min, total;
+        bench_measure(bench_memset_op, &b, ops, &min, &total);
+        bench_report("memset", sizes[i], ops, min, total, 0);
+    }
+    heap_free(data);
+    return 1;
+}
+
+int bench_memcpy_op(uint32_t i, void *ctx) {
+    bench_buffer *b = ctx;
+    // the second half of the buffer is the source.
+    memcpy(b->data, b->data + (1 << 20), b->size);
+    return 1;
+}
+
+int bench_memcpy() {
+    const uint32_t sizes[] = {64, 4096, 65536, 1 << 20};
+    uint8_t *data = heap_malloc(2 << 20);
+    if (!data) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_buffer b = {data, sizes[i]};
+        uint32_t ops = (4 << 20) / sizes[i];
+        uint64_t min, total;
+        bench_measure(bench_memcpy_op, &b, ops, &min, &total);
+        bench_report("memcpy", sizes[i], ops, min, total, 0);
+    }
+    heap_free(data);
+    return 1;
+}
+
+int bench_crc32c_op(uint32_t i, void *ctx) {
+    bench_buffer *b = ctx;
+    checksum_crc32c(i, b->data, b->size);
+    return 1;
+}
+
+int bench_inet_op(uint32_t i, void *ctx) {
+    bench_buffer *b = ctx;
+    checksum_inet(b->data, b->size);
+    return 1;
+}
+
+int bench_checksum() {
+    const uint32_t size = 65536;
+    uint8_t *data = heap_malloc(size);
+    if (!data) {
+        return 0;
+    }
+    memset(data, 0xA5, size);
+    bench_buffer b = {data, size};
+    uint32_t ops = (4 << 20) / size;
+    uint64_t min, total;
+    bench_measure(bench_crc32c_op, &b, ops, &min, &total);
+    bench_report((fpu_features() & FPU_FEATURE_SSE42) ? "crc32c_sse42"
+                                                      : "crc32c_table",
+                 size, ops, min, total, 1);
+    bench_measure(bench_inet_op, &b, ops, &min, &total);
+    bench_report((fpu_features() & FPU_FEATURE_SSE2) ? "inet_checksum_sse2"
+                                                     : "inet_checksum",
+                 size, ops, min, total, 1);
+    heap_free(data);
+    return 1;
+}
+
+int bench_heap_op(uint32_t i, void *ctx) {
+    void *p = heap_malloc(*(uint32_t *)ctx);
+    if (!p) {
+        return 0;
+    }
+    heap_free(p);
+    return 1;
+}
+
+// heap_malloc scans from the start of the heap, so the cost depends on how
+// much is allocated in front of the free space. Measure it with the boot
+// time allocations only and behind a fragmented run of live blocks.
+int bench_heap() {
+    const uint32_t sizes[] = {4096, 65536};
+    const uint32_t live = 256;
+    void **blocks = heap_zalloc(live * sizeof(void *));
+    if (!blocks) {
+        return 0;
+    }
+
+    int ok = 1;
+    for (uint32_t pass = 0; pass < 2 && ok; pass++) {
+        for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            uint32_t size = sizes[i];
+            uint64_t min, total;
+            ok = bench_measure(bench_heap_op, &size, 1000, &min, &total);
+            if (!ok) {
+                break;
+            }
+            bench_report(pass ? "heap_malloc_free_fragmented"
+                              : "heap_malloc_free",
+                         size, 1000, min, total, 0);
+        }
+        if (pass == 0) {
+            // every other block is freed, leaving one page holes.
+            for (uint32_t i = 0; i < live; i++) {
+                blocks[i] = heap_malloc(PAGE_SIZE);
+            }
+            for (uint32_t i = 0; i < live; i += 2) {
+                heap_free(blocks[i]);
+                blocks[i] = 0;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < live; i++) {
+        if (blocks[i]) {
+            heap_free(blocks[i]);
+        }
+    }
+    heap_free(blocks);
+    return ok;
+}
+
+typedef struct bench_paging_ctx {
+    page_directory_entry *table;
+    uint32_t physical;
+    uint32_t size;
+} bench_paging_ctx;
+
+int bench_paging_op(uint32_t i, void *ctx) {
+    bench_paging_ctx *p = ctx;
+    return paging_remap(p->table, BENCH_PAGING_BASE, p->physical, p->size,
+                        PAGING_PRESENT_F | PAGING_RW_F, false);
+}
+
+// Remap the same linear range over and over, its page table is allocated by
+// the first call so the measurement covers the PTE updates only.
+int bench_paging() {
+    const uint32_t pages[] = {1, 16, 256};
+    uint8_t *frames = heap_malloc(256 * PAGE_SIZE);
+    if (!frames) {
+        return 0;
+    }
+    bench_paging_ctx p = {paging_get_directory_table(), MEMORY_PHYS(frames), 0};
+
+    int ok = 1;
+    for (uint32_t i = 0; i < sizeof(pages) / sizeof(pages[0]) && ok; i++) {
+        p.size = pages[i] * PAGE_SIZE;
+        uint64_t min, total;
+        ok = bench_measure(bench_paging_op, &p, 100, &min, &total);
+        if (ok) {
+            bench_report("paging_remap", p.size, 100, min, total, 0);
+        }
+        paging_unmap(p.table, BENCH_PAGING_BASE, p.size);
+    }
+    heap_free(frames);
+    return ok;
+}
+
+void bench_interrupt() {}
+idt_handler(bench_handler_interrupt, bench_interrupt);
+
+int bench_interrupt_op(uint32_t i, void *ctx) {
+    asm volatile("int %0" : : "i"(BENCH_VECTOR) : "memory");
+    return 1;
+}
+
+// Round trip through an idt_handler stub with an empty C handler.
+int bench_interrupts() {
+    idt_set(BENCH_VECTOR, bench_handler_interrupt);
+    uint64_t min, total;
+    bench_measure(bench_interrupt_op, 0, 10000, &min, &total);
+    bench_report("interrupt_round_trip", 0, 10000, min, total, 0);
+    return 1;
+}
+
+#define BENCH_STR(x) #x
+#define BENCH_XSTR(x) BENCH_STR(x)
+
+// User program making BENCH_SYSCALL_OPS getpid calls through the vsyscall
+// entry at `offset`, then exiting.
+#define BENCH_SYSCALL_PROGRAM(name, offset)                           \
+    ".global " #name "\n"                                             \
+    ".global " #name "_end\n"                                         \
+    #name ":\n\t"                                                     \
+    "mov $" BENCH_XSTR(BENCH_SYSCALL_OPS) ", %esi\n\t"                \
+    "mov $(" BENCH_XSTR(SYSCALL_VSYSCALL_BASE) " + " BENCH_XSTR(      \
+        offset) "), %edi\n"                                           \
+    "1:\n\t"                                                          \
+    "mov $" BENCH_XSTR(SYSCALL_GETPID) ", %eax\n\t"                   \
+    "call *%edi\n\t"                                                  \
+    "dec %esi\n\t"                                                    \
+    "jnz 1b\n\t"                                                      \
+    "xor %ebx, %ebx\n\t"                                              \
+    "mov $" BENCH_XSTR(SYSCALL_EXIT) ", %eax\n\t"                     \
+    "call *%edi\n"                                                    \
+    #name "_end:\n"
+
+asm(".section .rodata\n"
+    BENCH_SYSCALL_PROGRAM(bench_user_int80, SYSCALL_VSYSCALL_INT80)
+    BENCH_SYSCALL_PROGRAM(bench_user_sysenter, SYSCALL_VSYSCALL_SYSENTER)
+    ".previous");
+extern const uint8_t bench_user_int80[], bench_user_int80_end[];
+extern const uint8_t bench_user_sysenter[], bench_user_sysenter_end[];
+
+int bench_syscall_op(uint32_t i, void *ctx) {
+    return process_run(ctx) == 0;
+}
+
+// Time a user program making BENCH_SYSCALL_OPS system calls, the process
+// entry and exit are amortized over the calls.
+int bench_syscall(const char *name, const uint8_t *start,
+                  const uint8_t *end) {
+    process *p = process_create(start, end - start);
+    if (!p) {
+        return 0;
+    }
+    uint64_t min, total;
+    int ok = bench_measure(bench_syscall_op, p, 1, &min, &total);
+    if (ok) {
+        bench_report(name, 0, BENCH_SYSCALL_OPS, min, total, 0);
+    }
+    process_destroy(p);
+    return ok;
+}
+
+int bench_syscalls() {
+    int ok = bench_syscall("syscall_int80", bench_user_int80,
+                           bench_user_int80_end);
+    if (syscall_sysenter_supported()) {
+        ok &= bench_syscall("syscall_sysenter", bench_user_sysenter,
+                            bench_user_sysenter_end);
+    }
+    return ok;
+}
+
+typedef struct bench_ata_ctx {
+    uint16_t bus;
+    uint8_t dev;
+    uint32_t sectors;
+    uint32_t count;
+    uint16_t *buffer;
+} bench_ata_ctx;
+
+int bench_ata_op(uint32_t i, void *ctx) {
+    bench_ata_ctx *a = ctx;
+    // sequential requests, wrapping within the disk.
+    uint32_t lba = (i * a->count) % (a->sectors - a->sectors % a->count);
+    return ata_read_sectors(a->bus, a->dev, lba, a->count, a->buffer);
+}
+
+// Sequential ata_read_sectors throughput, from the filesystem disk when
+// attached to IDE, the boot disk otherwise.
+int bench_ata_read() {
+    const uint32_t counts[] = {1, 8, 64, 256};
+    bench_ata_ctx a = {ATA_BUS_2, 0, 0, 0, 0};
+    ata_device *d = ata_get_device(a.bus, a.dev);
+    if (!d || !d->present) {
+        a.bus = ATA_BUS_1;
+        d = ata_get_device(a.bus, a.dev);
+    }
+    if (!d || !d->present) {
+        return 0;
+    }
+    // stay within the first 512MiB, the modulo below is 32 bit.
+    a.sectors = d->sectors < (1 << 20) ? d->sectors : (1 << 20);
+    a.buffer = heap_malloc(256 * ATA_SECTOR_SIZE);
+    if (!a.buffer) {
+        return 0;
+    }
+
+    int ok = 1;
+    for (uint32_t i = 0; i < sizeof(counts) / sizeof(counts[0]) && ok; i++) {
+        a.count = counts[i];
+        if (a.count > a.sectors) {
+            break;
+        }
+        // about 1MiB per round.
+        uint32_t ops = 2048 / a.count;
+        uint64_t min, total;
+        ok = bench_measure(bench_ata_op, &a, ops, &min, &total);
+        if (ok) {
+            bench_report("ata_read_sectors", a.count * ATA_SECTOR_SIZE, ops,
+                         min, total, 1);
+        }
+    }
+    heap_free(a.buffer);
+    // queue depth and latency seen by the reads above.
+    blk_dump();
+    return ok;
+}
+
+// Sleep until deadlines from well under one PIT countdown to several of them,
+// the longest ones are re-armed on every early interrupt.
+int bench_timer() {
+    const uint32_t durations[] = {50, 500, 5000, 20000, 100000};
+    for (uint32_t i = 0; i < sizeof(durations) / sizeof(durations[0]); i++) {
+        uint64_t cycles = timer_us_to_cycles(durations[i]);
+        uint64_t late_min = ~0ULL;
+        uint64_t late_max = 0;
+        uint64_t late_total = 0;
+        uint64_t wakeups = idle_get_cpu(0)->wakeups;
+        for (uint32_t j = 0; j < BENCH_TIMER_SLEEPS; j++) {
+            uint64_t deadline = timer_now() + cycles;
+            timer_sleep_until(deadline);
+            uint64_t late = timer_now() - deadline;
+            if (late < late_min) {
+                late_min = late;
+            }
+            if (late > late_max) {
+                late_max = late;
+            }
+            late_total += late;
+        }
+        wakeups = idle_get_cpu(0)->wakeups - wakeups;
+
+        serial_write_str("bench: name=timer_wakeup us=");
+        serial_write_dec(durations[i]);
+        serial_write_str(" ops=");
+        serial_write_dec(BENCH_TIMER_SLEEPS);
+        serial_write_str(" late_min=");
+        serial_write_dec(late_min);
+        serial_write_str(" late_avg=");
+        serial_write_dec(cpu_div64(late_total, BENCH_TIMER_SLEEPS));
+        serial_write_str(" late_max=");
+        serial_write_dec(late_max);
+        serial_write_str(" wakeups=");
+        serial_write_dec(wakeups);
+        serial_write_str("\n");
+    }
+    return 1;
+}
+
+int bench_run() {
+    bench_tsc_khz = timer_tsc_khz();
+    serial_write_str("bench: begin tsc_khz=");
+    serial_write_dec(bench_tsc_khz);
+    serial_write_str("\n");
+
+    int ok = 1;
+    // keep the timer out of the CPU bound measurements.
+    uint32_t flags = cpu_irq_save();
+    ok &= bench_memset();
+    ok &= bench_memcpy();
+    ok &= bench_checksum();
+    ok &= bench_heap();
+    ok &= bench_paging();
+    ok &= bench_interrupts();
+    cpu_irq_restore(flags);
+    // user code always runs with interrupts enabled.
+    ok &= bench_syscalls();
+    // sleeps halt until the timer interrupt.
+    ok &= bench_timer();
+    ok &= bench_ata_read();
+
+    serial_write_str(ok ? "bench: end status=ok\n" : "bench: end status=fail\n");
+    return ok;
+}
+
+void bench_exit(uint8_t code) { io_out8(BENCH_EXIT_PORT, code); }
@@ -0,0 +1,43 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// QEMU's isa-debug-exit device, writing `v` exits QEMU with status
+// (v << 1) | 1.
+#define BENCH_EXIT_PORT 0xF4
+#define BENCH_EXIT_SUCCESS 0
+#define BENCH_EXIT_FAILURE 1
+
+// Every measurement is repeated this many times, the fastest and the average
+// round are reported.
+#define BENCH_ROUNDS 5
+// Free vector used to time the interrupt round trip.
+#define BENCH_VECTOR 0x40
+// Linear address range used by the paging benchmark, outside any mapping.
+#define BENCH_PAGING_BASE 0x60000000
+// System calls per user program run by the system call benchmarks.
+#define BENCH_SYSCALL_OPS 10000
+// Sleeps per duration in the timer wakeup benchmark.
+#define BENCH_TIMER_SLEEPS 8
+
+// Run the benchmark suite and print the results over serial, one line per
+// measurement:
+//
+//   bench: begin tsc_khz=<n>
+//   bench: name=<name> size=<bytes> ops=<n> cycles_min=<n> cycles_avg=<n>
+//          [kib_per_sec=<n>]
+//   bench: name=timer_wakeup us=<n> ops=<n> late_min=<n> late_avg=<n>
+//          late_max=<n> wakeups=<n>
+//   bench: end status=<ok|fail>
+//
+// cycles are per operation, kib_per_sec is reported for I/O and checksums
+// and derived from the TSC frequency calibrated against the PIT. The timer
+// wakeup lines give how many TSC cycles past its deadline a sleep returned,
+// and the halts it took. Returns 1 if every benchmark ran.
+int bench_run();
+
+// Exit QEMU through isa-debug-exit, only returns when the device is absent.
+void bench_exit(uint8_t code);
+
+#endif  // BENCH_H
@@ -0,0 +1,24 @@
+#ifndef BOOT_INFO_H
+#define BOOT_INFO_H
+
+#include <stdint.h>
+
+// Load statistics left by the second stage boot loader, see src/boot/boot.inc.
+// Physical address, read through MEMORY_VIRT before paging_kernel_map's
+// directory is loaded and the low memory is reused.
+#define BOOT_INFO_ADDR 0x7000
+#define BOOT_INFO_MAGIC 0x464E4942  // "BINF"
+
+typedef struct boot_info {
+    uint32_t magic;
+    // TSC when the second stage started and when it jumped to the kernel.
+    uint64_t tsc_start;
+    uint64_t tsc_end;
+    // sectors read for the kernel payload, in bytes.
+    uint32_t disk_bytes;
+    // decompressed segment data, and segment sizes including BSS.
+    uint32_t image_bytes;
+    uint32_t memory_bytes;
+} __attribute__((packed)) boot_info;
+
+#endif  // BOOT_INFO_H
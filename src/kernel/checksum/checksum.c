@@ -0,0 +1,110 @@
+#include "checksum.h"
+
+#include <stdint.h>
+
+#include "../cpu/fpu.h"
+#include "../memory/memory.h"
+
+uint32_t checksum_crc32c_table[256];
+uint32_t (*checksum_crc32c_fn)(uint32_t crc, const uint8_t *p, uint32_t size);
+
+uint32_t checksum_crc32c_sw(uint32_t crc, const uint8_t *p, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+        crc = checksum_crc32c_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// crc32 works on general purpose registers, no kernel_fpu_begin needed.
+__attribute__((target("sse4.2"))) uint32_t checksum_crc32c_sse42(
+    uint32_t crc, const uint8_t *p, uint32_t size) {
+    for (; ((uint32_t)p & 3) && size; p++, size--) {
+        asm("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+    }
+    for (; size >= 4; p += 4, size -= 4) {
+        asm("crc32l %1, %0" : "+r"(crc) : "rm"(*(const uint32_t *)p));
+    }
+    for (; size; p++, size--) {
+        asm("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+    }
+    return crc;
+}
+
+void checksum_init() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CHECKSUM_CRC32C_POLY : 0);
+        }
+        checksum_crc32c_table[i] = crc;
+    }
+
+    checksum_crc32c_fn = (fpu_features() & FPU_FEATURE_SSE42)
+                             ? checksum_crc32c_sse42
+                             : checksum_crc32c_sw;
+}
+
+uint32_t checksum_crc32c(uint32_t crc, const void *data, uint32_t size) {
+    return ~checksum_crc32c_fn(~crc, data, size);
+}
+
+// Add `chunks` 16 byte chunks at `p` to `sum` as 16 bit words, widening them
+// to 32 bit lanes. Only valid inside a kernel_fpu_begin section.
+__attribute__((target("sse2"))) uint64_t checksum_inet_sse2(
+    const uint8_t *p, uint32_t chunks, uint64_t sum) {
+    // the stack is not 16 byte aligned in interrupt handlers.
+    uint32_t lanes[4];
+    asm volatile(
+        "pxor %%xmm0, %%xmm0\n\t"
+        "pxor %%xmm1, %%xmm1\n\t"
+        "pxor %%xmm7, %%xmm7\n\t"
+        "1:\n\t"
+        "movdqu (%1), %%xmm2\n\t"
+        "movdqa %%xmm2, %%xmm3\n\t"
+        "punpcklwd %%xmm7, %%xmm2\n\t"
+        "punpckhwd %%xmm7, %%xmm3\n\t"
+        "paddd %%xmm2, %%xmm0\n\t"
+        "paddd %%xmm3, %%xmm1\n\t"
+        "add $16, %1\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "paddd %%xmm1, %%xmm0\n\t"
+        "movdqu %%xmm0, %0"
+        : "=m"(lanes), "+r"(p), "+r"(chunks)
+        :
+        : "xmm0", "xmm1", "xmm2", "xmm3", "xmm7", "memory");
+    for (int i = 0; i < 4; i++) {
+        sum += lanes[i];
+    }
+    return sum;
+}
+
+uint16_t checksum_inet(const void *data, uint32_t size) {
+    const uint8_t *p = data;
+    uint64_t sum = 0;
+
+    if (size >= MEMORY_SIMD_MIN_SIZE && kernel_fpu_begin()) {
+        while (size >= 16) {
+            uint32_t chunks = size / 16;
+            if (chunks > CHECKSUM_INET_BATCH) {
+                chunks = CHECKSUM_INET_BATCH;
+            }
+            sum = checksum_inet_sse2(p, chunks, sum);
+            p += chunks * 16;
+            size -= chunks * 16;
+        }
+        kernel_fpu_end();
+    }
+
+    for (; size >= 2; p += 2, size -= 2) {
+        sum += *(const uint16_t *)p;
+    }
+    // an odd trailing byte is padded with zero.
+    if (size) {
+        sum += *p;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return ~sum & 0xFFFF;
+}
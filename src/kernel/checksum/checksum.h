@@ -0,0 +1,25 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+
+// CRC32C (Castagnoli), reflected polynomial.
+#define CHECKSUM_CRC32C_POLY 0x82F63B78
+// 16 byte SSE2 chunks summed before the 32 bit lanes are folded, each lane
+// then holds at most 0x8000 * 0xFFFF.
+#define CHECKSUM_INET_BATCH 0x8000
+
+// Pick the CRC32C implementation for this CPU, the SSE4.2 crc32 instruction
+// or a table driven fallback. Call after fpu_init.
+void checksum_init();
+
+// CRC32C of `size` bytes at `data`, continuing from `crc` (0 for a new
+// checksum).
+uint32_t checksum_crc32c(uint32_t crc, const void *data, uint32_t size);
+
+// RFC 1071 internet checksum of `size` bytes at `data`. The result is in the
+// data's byte order and can be stored into it as is. Large buffers are summed
+// with SSE2 when kernel_fpu_begin grants the registers.
+uint16_t checksum_inet(const void *data, uint32_t size);
+
+#endif  // CHECKSUM_H
@@ -0,0 +1,104 @@
+#include "cpu.h"
+
+#include <stdint.h>
+
+uint64_t cpu_rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint64_t cpu_div64(uint64_t n, uint64_t d) {
+    if (!d) {
+        return 0;
+    }
+    if (!(d >> 32)) {
+        // two divl steps, the first remainder is below d so the second
+        // quotient fits 32 bits.
+        uint32_t hi = n >> 32;
+        uint32_t q_hi = hi / (uint32_t)d;
+        uint32_t r = hi % (uint32_t)d;
+        uint32_t q_lo;
+        asm("divl %3"
+            : "=a"(q_lo), "+d"(r)
+            : "0"((uint32_t)n), "rm"((uint32_t)d));
+        return ((uint64_t)q_hi << 32) | q_lo;
+    }
+    // shift and subtract.
+    uint64_t q = 0;
+    uint64_t r = 0;
+    for (int i = 63; i >= 0; i--) {
+        r = (r << 1) | ((n >> i) & 1);
+        if (r >= d) {
+            r -= d;
+            q |= 1ULL << i;
+        }
+    }
+    return q;
+}
+
+void cpu_cpuid(uint32_t leaf, cpu_cpuid_regs *regs) {
+    asm volatile("cpuid"
+                 : "=a"(regs->eax), "=b"(regs->ebx), "=c"(regs->ecx),
+                   "=d"(regs->edx)
+                 : "a"(leaf), "c"(0));
+}
+
+uint64_t cpu_read_msr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+void cpu_write_msr(uint32_t msr, uint64_t value) {
+    asm volatile("wrmsr"
+                 :
+                 : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+uint32_t cpu_read_cr0() {
+    uint32_t value;
+    asm volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+void cpu_write_cr0(uint32_t value) {
+    asm volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+uint32_t cpu_read_cr4() {
+    uint32_t value;
+    asm volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+void cpu_write_cr4(uint32_t value) {
+    asm volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+uint32_t cpu_irq_save() {
+    uint32_t flags;
+    asm volatile(
+        "pushf\n\t"
+        "pop %0\n\t"
+        "cli"
+        : "=r"(flags)
+        :
+        : "memory");
+    return flags;
+}
+
+void cpu_irq_restore(uint32_t flags) {
+    if (flags & CPU_EFLAGS_IF) {
+        asm volatile("sti" : : : "memory");
+    }
+}
+
+int cpu_irq_enabled() {
+    uint32_t flags;
+    asm volatile(
+        "pushf\n\t"
+        "pop %0"
+        : "=r"(flags));
+    return (flags & CPU_EFLAGS_IF) != 0;
+}
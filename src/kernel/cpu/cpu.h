@@ -0,0 +1,51 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+#define CPU_EFLAGS_IF (1 << 9)
+
+// CPUID leaf reporting the feature flags.
+#define CPU_CPUID_FEATURES 1
+#define CPU_CPUID_EDX_FPU (1 << 0)
+#define CPU_CPUID_EDX_SEP (1 << 11)
+#define CPU_CPUID_EDX_PGE (1 << 13)
+#define CPU_CPUID_EDX_FXSR (1 << 24)
+#define CPU_CPUID_EDX_SSE (1 << 25)
+#define CPU_CPUID_EDX_SSE2 (1 << 26)
+#define CPU_CPUID_ECX_SSE42 (1 << 20)
+
+typedef struct cpu_cpuid_regs {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+} cpu_cpuid_regs;
+
+// Run CPUID for `leaf` (subleaf 0).
+void cpu_cpuid(uint32_t leaf, cpu_cpuid_regs *regs);
+
+// Read the time stamp counter.
+uint64_t cpu_rdtsc();
+
+// 64 bit unsigned division, libgcc is not linked. Returns 0 when `d` is 0.
+uint64_t cpu_div64(uint64_t n, uint64_t d);
+
+uint64_t cpu_read_msr(uint32_t msr);
+void cpu_write_msr(uint32_t msr, uint64_t value);
+
+uint32_t cpu_read_cr0();
+void cpu_write_cr0(uint32_t value);
+uint32_t cpu_read_cr4();
+void cpu_write_cr4(uint32_t value);
+
+// Disable interrupts, returning the previous EFLAGS for cpu_irq_restore.
+uint32_t cpu_irq_save();
+
+// Restore the interrupt flag saved by cpu_irq_save.
+void cpu_irq_restore(uint32_t flags);
+
+// Return 1 if interrupts are enabled on this CPU.
+int cpu_irq_enabled();
+
+#endif  // CPU_H
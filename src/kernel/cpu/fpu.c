@@ -0,0 +1,151 @@
+#include "fpu.h"
+
+#include <stdint.h>
+
+#include "../drivers/vga/vga.h"
+#include "../idt.h"
+#include "../memory/memory.h"
+#include "cpu.h"
+
+// Registers right after fninit, copied into new contexts.
+fpu_state fpu_reset_state;
+int fpu_enabled = 0;
+uint32_t fpu_feature_flags = 0;
+// State of the running context, 0 for the kernel.
+fpu_state *fpu_current = 0;
+// Context whose state is held in the registers, 0 if none is.
+fpu_state *fpu_owner = 0;
+// Set between kernel_fpu_begin and kernel_fpu_end.
+int fpu_kernel_active = 0;
+
+void fpu_save(fpu_state *state) {
+    asm volatile("fxsave %0" : "=m"(*state));
+}
+
+void fpu_restore(fpu_state *state) {
+    asm volatile("fxrstor %0" : : "m"(*state));
+}
+
+void fpu_clear_ts() { asm volatile("clts" : : : "memory"); }
+
+void fpu_set_ts() { cpu_write_cr0(cpu_read_cr0() | FPU_CR0_TS); }
+
+void fpu_nm(uint32_t *stack) {
+    // the kernel only uses the FPU inside kernel_fpu_begin sections, which
+    // clear TS, so this is a stray instruction.
+    if (!fpu_current) {
+        vga_write_str("FPU used outside kernel_fpu_begin\n", VGA_DEFAULT_CHAR);
+        *(stack + 8) = (uint32_t)halt;
+        return;
+    }
+
+    fpu_clear_ts();
+    if (fpu_owner == fpu_current) {
+        return;
+    }
+    if (fpu_owner) {
+        fpu_save(fpu_owner);
+    }
+    fpu_restore(fpu_current);
+    fpu_owner = fpu_current;
+}
+idt_handler(fpu_handler_nm, fpu_nm);
+
+int fpu_init() {
+    cpu_cpuid_regs regs;
+    cpu_cpuid(CPU_CPUID_FEATURES, &regs);
+    if (!(regs.edx & CPU_CPUID_EDX_FPU) || !(regs.edx & CPU_CPUID_EDX_FXSR)) {
+        return 0;
+    }
+
+    // native x87 error reporting, and WAIT honors TS like the FPU
+    // instructions do.
+    uint32_t cr0 = cpu_read_cr0();
+    cr0 &= ~(FPU_CR0_EM | FPU_CR0_TS);
+    cr0 |= FPU_CR0_MP | FPU_CR0_NE;
+    cpu_write_cr0(cr0);
+
+    uint32_t cr4 = cpu_read_cr4() | FPU_CR4_OSFXSR;
+    if (regs.edx & CPU_CPUID_EDX_SSE) {
+        cr4 |= FPU_CR4_OSXMMEXCPT;
+    }
+    cpu_write_cr4(cr4);
+
+    asm volatile("fninit");
+    fpu_save(&fpu_reset_state);
+
+    if ((regs.edx & CPU_CPUID_EDX_SSE) && (regs.edx & CPU_CPUID_EDX_SSE2)) {
+        fpu_feature_flags |= FPU_FEATURE_SSE2;
+    }
+    if (regs.ecx & CPU_CPUID_ECX_SSE42) {
+        fpu_feature_flags |= FPU_FEATURE_SSE42;
+    }
+
+    idt_set(FPU_NM_VECTOR, fpu_handler_nm);
+    fpu_set_ts();
+    fpu_enabled = 1;
+    return 1;
+}
+
+uint32_t fpu_features() { return fpu_feature_flags; }
+
+void fpu_state_init(fpu_state *state) {
+    memcpy(state, &fpu_reset_state, sizeof(fpu_state));
+}
+
+void fpu_switch(fpu_state *state) {
+    if (!fpu_enabled) {
+        return;
+    }
+    uint32_t flags = cpu_irq_save();
+    fpu_current = state;
+    if (state && state == fpu_owner) {
+        fpu_clear_ts();
+    } else {
+        fpu_set_ts();
+    }
+    cpu_irq_restore(flags);
+}
+
+void fpu_release(fpu_state *state) {
+    if (!fpu_enabled || !state) {
+        return;
+    }
+    uint32_t flags = cpu_irq_save();
+    if (fpu_current == state) {
+        fpu_current = 0;
+    }
+    if (fpu_owner == state) {
+        fpu_owner = 0;
+        fpu_set_ts();
+    }
+    cpu_irq_restore(flags);
+}
+
+int kernel_fpu_begin() {
+    if (!(fpu_feature_flags & FPU_FEATURE_SSE2)) {
+        return 0;
+    }
+    uint32_t flags = cpu_irq_save();
+    if (fpu_kernel_active) {
+        cpu_irq_restore(flags);
+        return 0;
+    }
+    fpu_kernel_active = 1;
+    fpu_clear_ts();
+    if (fpu_owner) {
+        fpu_save(fpu_owner);
+        fpu_owner = 0;
+    }
+    cpu_irq_restore(flags);
+    return 1;
+}
+
+void kernel_fpu_end() {
+    uint32_t flags = cpu_irq_save();
+    // nobody owns the registers now, the next context to use them faults and
+    // loads its state.
+    fpu_set_ts();
+    fpu_kernel_active = 0;
+    cpu_irq_restore(flags);
+}
@@ -0,0 +1,60 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+
+#define FPU_CR0_MP (1 << 1)
+#define FPU_CR0_EM (1 << 2)
+#define FPU_CR0_TS (1 << 3)
+#define FPU_CR0_NE (1 << 5)
+#define FPU_CR4_OSFXSR (1 << 9)
+#define FPU_CR4_OSXMMEXCPT (1 << 10)
+
+// device not available, raised by FPU/SSE instructions while CR0.TS is set.
+#define FPU_NM_VECTOR 7
+
+// Features found by fpu_init.
+#define FPU_FEATURE_SSE2 (1 << 0)
+#define FPU_FEATURE_SSE42 (1 << 1)
+
+// FXSAVE image of the x87, MMX and SSE registers.
+typedef struct fpu_state {
+    uint8_t fxsave[512];
+} __attribute__((aligned(16))) fpu_state;
+
+// Enable the FPU and SSE, and hook #NM to restore FPU state lazily. Returns 0
+// if the CPU lacks FXSAVE, SIMD stays off and kernel_fpu_begin always fails.
+//
+// The registers hold the state of at most one context, the owner. CR0.TS is
+// set whenever the running context is not the owner, its first FPU/SSE
+// instruction then raises #NM which saves the owner's state and loads its
+// own. Contexts which never touch the FPU never pay for FXSAVE/FXRSTOR.
+int fpu_init();
+
+// FPU_FEATURE_* flags supported by the CPU and enabled by fpu_init.
+uint32_t fpu_features();
+
+// Initialize `state` to the registers' reset state, for a new context.
+void fpu_state_init(fpu_state *state);
+
+// Make `state` the running context's FPU state, called when switching
+// contexts. 0 names the kernel, which has no FPU state of its own and may only
+// use the FPU between kernel_fpu_begin and kernel_fpu_end.
+void fpu_switch(fpu_state *state);
+
+// Forget `state` before its memory is freed, if the registers hold it they
+// are dropped without saving and TS is set.
+void fpu_release(fpu_state *state);
+
+// Claim the FPU/SSE registers for kernel code, saving the owner's state first
+// if it is live. Returns 0 without claiming them if SSE2 is unavailable or
+// the registers are already claimed (an interrupt handler running inside
+// another kernel_fpu_begin section), callers then fall back to scalar code.
+//
+// Sections must be short and must not switch contexts.
+int kernel_fpu_begin();
+
+// Release the registers claimed by kernel_fpu_begin, their contents are lost.
+void kernel_fpu_end();
+
+#endif  // FPU_H
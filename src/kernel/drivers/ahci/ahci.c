@@ -0,0 +1,448 @@
+#include "ahci.h"
+
+#include <stdint.h>
+
+#include "../../memory/heap.h"
+#include "../../memory/memory.h"
+#include "../../memory/paging.h"
+#include "../ata/ata.h"
+#include "../pci/pci.h"
+#include "../pic/pic.h"
+
+// command list (1KiB aligned) and received FIS area (256 byte aligned) share
+// one page per port.
+#define AHCI_CMD_LIST_OFFSET 0
+#define AHCI_FIS_OFFSET 0x400
+
+volatile uint8_t *ahci_abar;
+uint32_t ahci_slots;
+
+ahci_port ahci_ports[AHCI_MAX_DEVICES];
+uint32_t ahci_port_count;
+
+const char *ahci_device_names[AHCI_MAX_DEVICES] = {"sda", "sdb", "sdc",
+                                                   "sdd"};
+
+uint32_t ahci_read(uint32_t reg) {
+    return *(volatile uint32_t *)(ahci_abar + reg);
+}
+
+void ahci_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(ahci_abar + reg) = value;
+}
+
+uint32_t ahci_port_read(const ahci_port *p, uint32_t reg) {
+    return ahci_read(AHCI_PORT_BASE(p->index) + reg);
+}
+
+void ahci_port_write(const ahci_port *p, uint32_t reg, uint32_t value) {
+    ahci_write(AHCI_PORT_BASE(p->index) + reg, value);
+}
+
+// Wait for the port register bits in `mask` to read as `value`, returns 0 on
+// timeout.
+int ahci_port_wait(const ahci_port *p, uint32_t reg, uint32_t mask,
+                   uint32_t value) {
+    for (uint32_t i = 0; i < AHCI_SPIN_LIMIT; i++) {
+        if ((ahci_port_read(p, reg) & mask) == value) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Stop command processing and FIS reception, the HBA clears PxCI and PxSACT.
+int ahci_port_stop(const ahci_port *p) {
+    uint32_t cmd = ahci_port_read(p, AHCI_PORT_CMD);
+    ahci_port_write(p, AHCI_PORT_CMD, cmd & ~AHCI_PORT_CMD_ST);
+    if (!ahci_port_wait(p, AHCI_PORT_CMD, AHCI_PORT_CMD_CR, 0)) {
+        return 0;
+    }
+    cmd = ahci_port_read(p, AHCI_PORT_CMD);
+    ahci_port_write(p, AHCI_PORT_CMD, cmd & ~AHCI_PORT_CMD_FRE);
+    return ahci_port_wait(p, AHCI_PORT_CMD, AHCI_PORT_CMD_FR, 0);
+}
+
+int ahci_port_start(const ahci_port *p) {
+    if (!ahci_port_wait(p, AHCI_PORT_CMD, AHCI_PORT_CMD_CR, 0)) {
+        return 0;
+    }
+    uint32_t cmd = ahci_port_read(p, AHCI_PORT_CMD);
+    ahci_port_write(p, AHCI_PORT_CMD, cmd | AHCI_PORT_CMD_FRE);
+    ahci_port_write(p, AHCI_PORT_CMD,
+                    cmd | AHCI_PORT_CMD_FRE | AHCI_PORT_CMD_ST);
+    return 1;
+}
+
+void ahci_build_fis(ahci_cmd_table *table, uint8_t command, uint64_t lba,
+                    uint16_t count, uint16_t feature, uint8_t device) {
+    ahci_fis_h2d *fis = (ahci_fis_h2d *)table->cfis;
+    memset(fis, 0, sizeof(ahci_fis_h2d));
+    fis->type = AHCI_FIS_TYPE_H2D;
+    fis->flags = AHCI_FIS_H2D_COMMAND;
+    fis->command = command;
+    fis->feature_low = feature & 0xFF;
+    fis->feature_high = feature >> 8;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+    fis->device = device;
+    fis->count_low = count & 0xFF;
+    fis->count_high = count >> 8;
+}
+
+void ahci_build_header(ahci_port *p, uint32_t slot, uint16_t prds,
+                       int write) {
+    ahci_cmd_header *h = &p->cmd_list[slot];
+    h->flags = sizeof(ahci_fis_h2d) / 4 | (write ? AHCI_CMD_HEADER_WRITE : 0);
+    h->prdtl = prds;
+    h->prdbc = 0;
+}
+
+// Run a non-queued command in slot 0 and poll for its completion, used while
+// the port has no queued commands outstanding (during probe and error
+// recovery).
+int ahci_port_exec(ahci_port *p, uint8_t command, uint64_t lba,
+                   uint16_t count, void *buffer, uint32_t bytes) {
+    ahci_cmd_table *table = p->tables[0];
+    ahci_build_fis(table, command, lba, count, 0, AHCI_FIS_DEVICE_LBA);
+    table->prdt[0].dba = MEMORY_PHYS(buffer);
+    table->prdt[0].dbau = 0;
+    table->prdt[0].dbc = bytes - 1;
+    ahci_build_header(p, 0, 1, 0);
+
+    if (!ahci_port_wait(p, AHCI_PORT_TFD,
+                        AHCI_PORT_TFD_BSY | AHCI_PORT_TFD_DRQ, 0)) {
+        return 0;
+    }
+    ahci_port_write(p, AHCI_PORT_CI, 1);
+
+    for (uint32_t i = 0; i < AHCI_SPIN_LIMIT; i++) {
+        if (ahci_port_read(p, AHCI_PORT_IS) & AHCI_PORT_IS_TFES) {
+            break;
+        }
+        if (!(ahci_port_read(p, AHCI_PORT_CI) & 1)) {
+            int ok = !(ahci_port_read(p, AHCI_PORT_TFD) & AHCI_PORT_TFD_ERR);
+            ahci_port_write(p, AHCI_PORT_IS, ahci_port_read(p, AHCI_PORT_IS));
+            return ok;
+        }
+    }
+    ahci_port_write(p, AHCI_PORT_IS, ahci_port_read(p, AHCI_PORT_IS));
+    return 0;
+}
+
+// blk_queue start routine, prepares a READ/WRITE FPDMA QUEUED command in a
+// free slot. The slots prepared during one dispatch round are issued
+// together by ahci_commit.
+int ahci_start(blk_queue *q, blk_request *req) {
+    ahci_port *p = q->priv;
+    if (!p->free_slots) {
+        return 0;
+    }
+    uint32_t slot = __builtin_ctz(p->free_slots);
+    p->free_slots &= ~(1u << slot);
+    p->slots[slot] = req;
+
+    // the queue limits keep every segment within one PRD.
+    ahci_cmd_table *table = p->tables[slot];
+    for (uint32_t i = 0; i < req->seg_count; i++) {
+        table->prdt[i].dba = req->segs[i].page + req->segs[i].offset;
+        table->prdt[i].dbau = 0;
+        table->prdt[i].dbc = req->segs[i].length - 1;
+    }
+
+    // queued commands carry the sector count in the feature field and their
+    // tag in bits 3-7 of the count field.
+    ahci_build_fis(table,
+                   req->write ? ATA_COMMAND_WRITE_FPDMA_QUEUED
+                              : ATA_COMMAND_READ_FPDMA_QUEUED,
+                   req->lba, slot << 3, req->sectors & 0xFFFF,
+                   AHCI_FIS_DEVICE_LBA | (req->write ? AHCI_FIS_DEVICE_FUA : 0));
+    ahci_build_header(p, slot, req->seg_count, req->write);
+
+    p->to_issue |= 1u << slot;
+    return 1;
+}
+
+void ahci_commit(blk_queue *q) {
+    ahci_port *p = q->priv;
+    if (!p->to_issue) {
+        return;
+    }
+    // PxSACT must be set before the slot is issued through PxCI.
+    ahci_port_write(p, AHCI_PORT_SACT, p->to_issue);
+    ahci_port_write(p, AHCI_PORT_CI, p->to_issue);
+    p->issued |= p->to_issue;
+    p->to_issue = 0;
+}
+
+void ahci_complete(ahci_port *p, uint32_t done, int ok) {
+    while (done) {
+        uint32_t slot = __builtin_ctz(done);
+        done &= ~(1u << slot);
+        blk_request *req = p->slots[slot];
+        p->slots[slot] = 0;
+        p->issued &= ~(1u << slot);
+        p->free_slots |= 1u << slot;
+        blk_queue_complete(&p->queue, req, ok);
+    }
+}
+
+// A queued command failed, the device aborted every outstanding command and
+// stays in an error state until its NCQ error log is read.
+//
+// The port is restarted, the log read and all the outstanding commands are
+// failed.
+void ahci_recover(ahci_port *p) {
+    uint32_t outstanding = p->issued;
+
+    ahci_port_stop(p);
+    ahci_port_write(p, AHCI_PORT_SERR, 0xFFFFFFFF);
+    ahci_port_write(p, AHCI_PORT_IS, 0xFFFFFFFF);
+    ahci_port_start(p);
+
+    uint8_t *log = heap_zalloc(ATA_SECTOR_SIZE);
+    if (log) {
+        ahci_port_exec(p, ATA_COMMAND_READ_LOG_EXT, AHCI_LOG_NCQ_ERROR, 1, log,
+                       ATA_SECTOR_SIZE);
+        heap_free(log);
+    }
+
+    ahci_complete(p, outstanding, 0);
+}
+
+// Complete the port's finished commands, called from the controller's IRQ
+// handler or, when interrupts are disabled, polled by blk_wait.
+//
+// A command is done once its bit cleared in both PxSACT (set device bits
+// FIS) and PxCI, so calling this with nothing to do is harmless.
+void ahci_service(ahci_port *p) {
+    uint32_t is = ahci_port_read(p, AHCI_PORT_IS);
+    ahci_port_write(p, AHCI_PORT_IS, is);
+    ahci_write(AHCI_HBA_IS, 1u << p->index);
+
+    if (is & AHCI_PORT_IS_ERROR) {
+        ahci_recover(p);
+        return;
+    }
+
+    uint32_t busy = ahci_port_read(p, AHCI_PORT_SACT) |
+                    ahci_port_read(p, AHCI_PORT_CI);
+    ahci_complete(p, p->issued & ~busy, 1);
+}
+
+void ahci_poll(blk_queue *q) { ahci_service(q->priv); }
+
+// Shared line handler, nothing is pending when the HBA did not interrupt.
+void ahci_irq_handler(void *ctx) {
+    uint32_t pending = ahci_read(AHCI_HBA_IS);
+    for (uint32_t i = 0; i < ahci_port_count; i++) {
+        if (pending & (1u << ahci_ports[i].index)) {
+            ahci_service(&ahci_ports[i]);
+        }
+    }
+    // acknowledge ports which are not registered.
+    ahci_write(AHCI_HBA_IS, pending);
+}
+
+// Stop the port and free what ahci_port_init allocated for it. The memory is
+// kept if the port does not stop, the HBA may still be using it.
+void ahci_port_free(ahci_port *p) {
+    if (!ahci_port_stop(p)) {
+        return;
+    }
+    for (uint32_t i = 0; i < AHCI_MAX_SLOTS; i++) {
+        if (p->tables[i]) {
+            heap_free(p->tables[i]);
+            p->tables[i] = 0;
+        }
+    }
+    if (p->cmd_list) {
+        heap_free((uint8_t *)p->cmd_list - AHCI_CMD_LIST_OFFSET);
+        p->cmd_list = 0;
+        p->fis = 0;
+    }
+}
+
+// Allocate the port's command list, received FIS area and command tables,
+// then identify the disk. Returns 0, with the memory freed, if the port can
+// not be used.
+int ahci_port_init(ahci_port *p) {
+    if (!ahci_port_stop(p)) {
+        return 0;
+    }
+
+    uint8_t *mem = heap_zalloc(PAGE_SIZE);
+    if (!mem) {
+        return 0;
+    }
+    p->cmd_list = (ahci_cmd_header *)(mem + AHCI_CMD_LIST_OFFSET);
+    p->fis = mem + AHCI_FIS_OFFSET;
+    for (uint32_t i = 0; i < ahci_slots; i++) {
+        p->tables[i] = heap_zalloc(PAGE_SIZE);
+        if (!p->tables[i]) {
+            ahci_port_free(p);
+            return 0;
+        }
+        p->cmd_list[i].ctba = MEMORY_PHYS(p->tables[i]);
+        p->cmd_list[i].ctbau = 0;
+    }
+
+    ahci_port_write(p, AHCI_PORT_CLB, MEMORY_PHYS(p->cmd_list));
+    ahci_port_write(p, AHCI_PORT_CLBU, 0);
+    ahci_port_write(p, AHCI_PORT_FB, MEMORY_PHYS(p->fis));
+    ahci_port_write(p, AHCI_PORT_FBU, 0);
+    ahci_port_write(p, AHCI_PORT_SERR, 0xFFFFFFFF);
+    ahci_port_write(p, AHCI_PORT_IS, 0xFFFFFFFF);
+    if (!ahci_port_start(p)) {
+        ahci_port_free(p);
+        return 0;
+    }
+
+    uint16_t *id = heap_zalloc(ATA_SECTOR_SIZE);
+    if (!id) {
+        ahci_port_free(p);
+        return 0;
+    }
+    int ok = ahci_port_exec(p, ATA_COMMAND_IDENTIFY, 0, 0, id,
+                            ATA_SECTOR_SIZE);
+    if (ok) {
+        p->sectors = ((uint64_t)id[ATA_IDENTIFY_SECTORS_ONE] |
+                      (uint64_t)id[ATA_IDENTIFY_SECTORS_TWO] << 16 |
+                      (uint64_t)id[ATA_IDENTIFY_SECTORS_THREE] << 32 |
+                      (uint64_t)id[ATA_IDENTIFY_SECTORS_FOUR] << 48);
+        // the disk's queue depth, bounded by the HBA's command slots.
+        p->depth = 0;
+        if (id[ATA_IDENTIFY_SATA_CAPABILITIES] & ATA_IDENTIFY_SATA_NCQ_F) {
+            p->depth = (id[ATA_IDENTIFY_QUEUE_DEPTH] & 0x1F) + 1;
+            if (p->depth > ahci_slots) {
+                p->depth = ahci_slots;
+            }
+        }
+    }
+    heap_free(id);
+
+    if (!ok || !p->sectors || !p->depth) {
+        ahci_port_free(p);
+        return 0;
+    }
+
+    p->free_slots = p->depth == 32 ? 0xFFFFFFFF : (1u << p->depth) - 1;
+    ahci_port_write(p, AHCI_PORT_IE,
+                    AHCI_PORT_IS_DHRS | AHCI_PORT_IS_SDBS | AHCI_PORT_IS_ERROR);
+    return 1;
+}
+
+int ahci_init() {
+    pci_device pci;
+    uint32_t n = 0;
+    do {
+        if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, n++, &pci)) {
+            return 0;
+        }
+    } while (pci.prog_if != AHCI_PCI_PROG_IF ||
+             (pci.bar[AHCI_PCI_ABAR] & PCI_BAR_IO_F));
+
+    // ABAR lies outside the kernel's direct map, map it uncached.
+    ahci_abar = paging_map_mmio(pci.bar[AHCI_PCI_ABAR] & PCI_BAR_MEM_MASK,
+                                AHCI_ABAR_SIZE);
+    if (!ahci_abar) {
+        return 0;
+    }
+    pci_enable(&pci);
+
+    ahci_write(AHCI_HBA_GHC, ahci_read(AHCI_HBA_GHC) | AHCI_GHC_AE);
+    uint32_t cap = ahci_read(AHCI_HBA_CAP);
+    // queued commands are the point of this driver, disks on an HBA without
+    // NCQ are left to the IDE driver.
+    if (!(cap & AHCI_CAP_SNCQ)) {
+        return 0;
+    }
+    ahci_slots = AHCI_CAP_NCS(cap);
+    // the HBA's interrupt stays disabled until every port is set up.
+    if (!pic_irq_register(pci.irq_line, ahci_irq_handler, 0)) {
+        return 0;
+    }
+
+    memset(ahci_ports, 0, sizeof(ahci_ports));
+    ahci_port_count = 0;
+
+    uint32_t implemented = ahci_read(AHCI_HBA_PI);
+    for (uint32_t i = 0;
+         i < AHCI_MAX_PORTS && ahci_port_count < AHCI_MAX_DEVICES; i++) {
+        ahci_port *p = &ahci_ports[ahci_port_count];
+        p->index = i;
+        if (!(implemented & (1u << i)) ||
+            AHCI_PORT_SSTS_DET(ahci_port_read(p, AHCI_PORT_SSTS)) !=
+                AHCI_PORT_SSTS_DET_PRESENT ||
+            ahci_port_read(p, AHCI_PORT_SIG) != AHCI_PORT_SIG_ATA) {
+            continue;
+        }
+        if (!ahci_port_init(p)) {
+            memset(p, 0, sizeof(ahci_port));
+            continue;
+        }
+
+        blk_queue_init(&p->queue, p->depth, AHCI_FPDMA_MAX_SECTORS,
+                       AHCI_PRDT_ENTRIES, AHCI_PRD_MAX_BYTES, ahci_start,
+                       ahci_poll, p);
+        p->queue.commit = ahci_commit;
+
+        p->blk.name = ahci_device_names[ahci_port_count];
+        p->blk.sectors = p->sectors;
+        p->blk.queue = &p->queue;
+        p->blk.priv = p;
+        blk_register(&p->blk);
+        ahci_port_count++;
+    }
+
+    // completions are interrupt driven from here on.
+    ahci_write(AHCI_HBA_IS, ahci_read(AHCI_HBA_IS));
+    ahci_write(AHCI_HBA_GHC, ahci_read(AHCI_HBA_GHC) | AHCI_GHC_IE);
+    return ahci_port_count != 0;
+}
+
+uint32_t ahci_queue_depth(uint8_t dev) {
+    return dev < ahci_port_count ? ahci_ports[dev].depth : 0;
+}
+
+// Validate a single buffer request against the disk, like
+// ata_buffer_segment.
+ahci_port *ahci_buffer_segment(uint8_t dev, uint64_t start_lba,
+                               uint64_t count, const void *buffer,
+                               blk_segment *seg) {
+    if (dev >= ahci_port_count || !count) {
+        return 0;
+    }
+    ahci_port *p = &ahci_ports[dev];
+    if (start_lba >= p->sectors || count > p->sectors - start_lba) {
+        return 0;
+    }
+    seg->page = MEMORY_PHYS(buffer);
+    seg->offset = 0;
+    seg->length = count * ATA_SECTOR_SIZE;
+    return p;
+}
+
+int ahci_read_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                      uint16_t buffer[]) {
+    blk_segment seg;
+    ahci_port *p = ahci_buffer_segment(dev, start_lba, count, buffer, &seg);
+    if (!p) {
+        return 0;
+    }
+    return blk_readv(&p->blk, start_lba, &seg, 1);
+}
+
+int ahci_write_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                       const uint16_t buffer[]) {
+    blk_segment seg;
+    ahci_port *p = ahci_buffer_segment(dev, start_lba, count, buffer, &seg);
+    if (!p) {
+        return 0;
+    }
+    return blk_writev(&p->blk, start_lba, &seg, 1);
+}
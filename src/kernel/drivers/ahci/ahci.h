@@ -0,0 +1,184 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+
+#include "../blk/blk.h"
+
+// PCI programming interface of an AHCI SATA controller.
+#define AHCI_PCI_PROG_IF 0x01
+// ABAR, the HBA's memory mapped registers, is BAR5.
+#define AHCI_PCI_ABAR 5
+// generic host control plus 32 ports of registers.
+#define AHCI_ABAR_SIZE 0x1100
+
+// generic host control registers, relative to ABAR.
+#define AHCI_HBA_CAP 0x00
+#define AHCI_HBA_GHC 0x04
+#define AHCI_HBA_IS 0x08
+#define AHCI_HBA_PI 0x0C
+#define AHCI_HBA_VS 0x10
+
+#define AHCI_CAP_NCS(cap) ((((cap) >> 8) & 0x1F) + 1)
+#define AHCI_CAP_SNCQ (1 << 30)
+
+#define AHCI_GHC_IE (1 << 1)
+#define AHCI_GHC_AE (1u << 31)
+
+// port registers, relative to AHCI_PORT_BASE(port).
+#define AHCI_PORT_BASE(port) (0x100 + (port) * 0x80)
+#define AHCI_PORT_CLB 0x00
+#define AHCI_PORT_CLBU 0x04
+#define AHCI_PORT_FB 0x08
+#define AHCI_PORT_FBU 0x0C
+#define AHCI_PORT_IS 0x10
+#define AHCI_PORT_IE 0x14
+#define AHCI_PORT_CMD 0x18
+#define AHCI_PORT_TFD 0x20
+#define AHCI_PORT_SIG 0x24
+#define AHCI_PORT_SSTS 0x28
+#define AHCI_PORT_SERR 0x30
+#define AHCI_PORT_SACT 0x34
+#define AHCI_PORT_CI 0x38
+
+#define AHCI_PORT_CMD_ST (1 << 0)
+#define AHCI_PORT_CMD_FRE (1 << 4)
+#define AHCI_PORT_CMD_FR (1 << 14)
+#define AHCI_PORT_CMD_CR (1 << 15)
+
+#define AHCI_PORT_IS_DHRS (1 << 0)
+#define AHCI_PORT_IS_PSS (1 << 1)
+#define AHCI_PORT_IS_SDBS (1 << 3)
+#define AHCI_PORT_IS_IFS (1 << 27)
+#define AHCI_PORT_IS_HBDS (1 << 28)
+#define AHCI_PORT_IS_HBFS (1 << 29)
+#define AHCI_PORT_IS_TFES (1 << 30)
+#define AHCI_PORT_IS_ERROR                                           \
+    (AHCI_PORT_IS_IFS | AHCI_PORT_IS_HBDS | AHCI_PORT_IS_HBFS | \
+     AHCI_PORT_IS_TFES)
+
+#define AHCI_PORT_TFD_ERR (1 << 0)
+#define AHCI_PORT_TFD_DRQ (1 << 3)
+#define AHCI_PORT_TFD_BSY (1 << 7)
+
+// device detected and phy communication established.
+#define AHCI_PORT_SSTS_DET(ssts) ((ssts) & 0xF)
+#define AHCI_PORT_SSTS_DET_PRESENT 3
+#define AHCI_PORT_SIG_ATA 0x00000101
+
+#define AHCI_MAX_PORTS 32
+#define AHCI_MAX_SLOTS 32
+// Ports registered as block devices, "sda" to "sdd".
+#define AHCI_MAX_DEVICES 4
+
+// command header flags, the FIS length in dwords is in bits 0-4.
+#define AHCI_CMD_HEADER_WRITE (1 << 6)
+
+#define AHCI_FIS_TYPE_H2D 0x27
+// the FIS carries a command rather than a device control update.
+#define AHCI_FIS_H2D_COMMAND 0x80
+#define AHCI_FIS_DEVICE_LBA 0x40
+// force unit access, the device reports the write once it is durable.
+#define AHCI_FIS_DEVICE_FUA 0x80
+
+// A PRD moves at most 4MiB, its byte count is stored minus one.
+#define AHCI_PRD_MAX_BYTES 0x400000
+// PRD entries per command table, a table (0x80 bytes of FIS area followed by
+// the PRDT) fits in one page.
+#define AHCI_PRDT_ENTRIES BLK_REQUEST_MAX_SEGMENTS
+
+// sector count of a queued command, stored in the FIS feature field, 0
+// meaning 65536.
+#define AHCI_FPDMA_MAX_SECTORS 0x10000
+// log page reporting the failed tag of a queued command, reading it takes
+// the device out of its error state.
+#define AHCI_LOG_NCQ_ERROR 0x10
+
+// bound on register polling loops, in iterations.
+#define AHCI_SPIN_LIMIT 1000000
+
+typedef struct ahci_cmd_header {
+    uint16_t flags;
+    uint16_t prdtl;
+    volatile uint32_t prdbc;
+    uint32_t ctba;
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed)) ahci_cmd_header;
+
+typedef struct ahci_prd {
+    uint32_t dba;
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;
+} __attribute__((packed)) ahci_prd;
+
+// Register host to device FIS.
+typedef struct ahci_fis_h2d {
+    uint8_t type;
+    uint8_t flags;
+    uint8_t command;
+    uint8_t feature_low;
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t feature_high;
+    uint8_t count_low;
+    uint8_t count_high;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed)) ahci_fis_h2d;
+
+typedef struct ahci_cmd_table {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    ahci_prd prdt[AHCI_PRDT_ENTRIES];
+} __attribute__((packed)) ahci_cmd_table;
+
+// Per port state, each port runs its own queue of up to `depth` NCQ commands,
+// command slot n carries queue tag n.
+typedef struct ahci_port {
+    uint32_t index;
+    ahci_cmd_header *cmd_list;
+    uint8_t *fis;
+    ahci_cmd_table *tables[AHCI_MAX_SLOTS];
+    blk_request *slots[AHCI_MAX_SLOTS];
+    // bit n set when slot n is free.
+    uint32_t free_slots;
+    // slots prepared by the queue's start and not yet handed to the HBA.
+    uint32_t to_issue;
+    // slots handed to the HBA and not yet completed.
+    uint32_t issued;
+    uint32_t depth;
+    uint64_t sectors;
+    blk_device blk;
+    blk_queue queue;
+} ahci_port;
+
+// Find an AHCI controller on PCI and register every SATA disk supporting
+// native command queuing as a block device, "sda" for the lowest port.
+//
+// Each port is serviced by its own request queue, which keeps up to the
+// disk's queue depth of READ/WRITE FPDMA QUEUED commands in flight and is
+// completed from the controller's interrupt.
+int ahci_init();
+
+// NCQ depth used for disk `dev`, 0 if there is no such disk.
+uint32_t ahci_queue_depth(uint8_t dev);
+
+// Same semantics as ata_read_sectors, for AHCI disk `dev`.
+int ahci_read_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                      uint16_t buffer[]);
+
+// Same semantics as ata_write_sectors, for AHCI disk `dev`. Writes are
+// issued with FUA set rather than followed by a cache flush.
+int ahci_write_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                       const uint16_t buffer[]);
+
+#endif  // AHCI_H
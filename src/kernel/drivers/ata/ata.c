@@ -4,12 +4,20 @@
 
 #include "../../io/io.h"
 #include "../../memory/heap.h"
+#include "../../memory/memory.h"
+#include "../pci/pci.h"
+#include "../pic/pic.h"
 
 // Array to hold detected ATA devices.
 //
 // The 'present' bit will be set if the device is detected.
 ata_device devices[4];
 
+const char *ata_device_names[4] = {"ata0", "ata1", "ata2", "ata3"};
+
+// Bus master DMA state for ATA_BUS_1 and ATA_BUS_2.
+ata_channel channels[2];
+
 typedef union {
     uint8_t i;
     struct {
@@ -51,6 +59,15 @@ ata_status ata_get_status(uint16_t bus) {
     return s;
 }
 
+// Wait for BSY to clear, returns 0 if the device reports an error.
+int ata_wait_ready(uint16_t bus) {
+    ata_status s = {0};
+    do {
+        s = ata_get_status(bus);
+    } while (s.bsy);
+    return !s.err_chk && !s.df_se;
+}
+
 int ata_wait_or_error(uint16_t bus) {
     ata_status s = {0};
     do {
@@ -122,9 +139,204 @@ int ata_probe_devices(uint16_t bus) {
     return 1;
 };
 
-// Use 48-bit LBA and READ EXT command semantics to read the requested sectors
-int ata_read_sectors(uint16_t bus, uint8_t dev, uint64_t start_lba,
-                     uint64_t count, uint16_t buffer[]) {
+// Program the 48-bit LBA and sector count registers and issue `command`.
+//
+// A `count` of ATA_SECTOR_MAX_COUNT is encoded as 0.
+void ata_command(uint16_t bus, uint64_t lba, uint32_t count, uint8_t command) {
+    // double writes to registers are used for EXT commands.
+    // multi-bytes are written as high bits first, low bits last.
+    io_out8(ATA_PORT_SECTOR_COUNT(bus), ATA_SECTOR_COUNT_ONE(count));
+    io_out8(ATA_PORT_SECTOR_COUNT(bus), ATA_SECTOR_COUNT_TWO(count));
+
+    io_out8(ATA_PORT_LBA_LOW(bus), ATA_LBA_LOW_ONE(lba));
+    io_out8(ATA_PORT_LBA_LOW(bus), ATA_LBA_LOW_TWO(lba));
+    io_out8(ATA_PORT_LBA_MID(bus), ATA_LBA_MID_ONE(lba));
+    io_out8(ATA_PORT_LBA_MID(bus), ATA_LBA_MID_TWO(lba));
+    io_out8(ATA_PORT_LBA_HIGH(bus), ATA_LBA_HIGH_ONE(lba));
+    io_out8(ATA_PORT_LBA_HIGH(bus), ATA_LBA_HIGH_TWO(lba));
+
+    io_out8(ATA_PORT_COMMAND_STATUS(bus), command);
+}
+
+int ata_flush(uint16_t bus) {
+    io_out8(ATA_PORT_COMMAND_STATUS(bus), ATA_COMMAND_FLUSH_EXT);
+    ata_delay(bus);
+    return ata_wait_ready(bus);
+}
+
+uint16_t *ata_cursor_next(ata_cursor *c) {
+    const blk_segment *seg = &c->segs[c->index];
+    uint16_t *p = MEMORY_VIRT(seg->page + seg->offset + c->offset);
+    c->offset += ATA_SECTOR_SIZE;
+    if (c->offset == seg->length) {
+        c->index++;
+        c->offset = 0;
+    }
+    return p;
+}
+
+void ata_pio_sector(uint16_t bus, ata_cursor *c, int write) {
+    uint16_t *p = ata_cursor_next(c);
+    for (int j = 0; j < 256; j++) {
+        if (write) {
+            io_out16(ATA_PORT_DATA(bus), p[j]);
+        } else {
+            p[j] = io_ins16(ATA_PORT_DATA(bus));
+        }
+    }
+}
+
+// Describe the request's segments in the channel's PRD table, each segment
+// becomes one or more entries so data moves directly between the disk and
+// its destination. The queue limits guarantee the table is large enough.
+void ata_build_prdt(ata_channel *ch, blk_request *req) {
+    uint32_t prds = 0;
+    for (uint32_t i = 0; i < req->seg_count; i++) {
+        uint32_t addr = req->segs[i].page + req->segs[i].offset;
+        uint32_t length = req->segs[i].length;
+        while (length) {
+            uint32_t chunk =
+                ATA_PRD_MAX_BYTES - (addr & (ATA_PRD_MAX_BYTES - 1));
+            if (chunk > length) {
+                chunk = length;
+            }
+            ch->prdt[prds].address = addr;
+            ch->prdt[prds].bytes = chunk & 0xFFFF;
+            ch->prdt[prds].flags = 0;
+            prds++;
+            addr += chunk;
+            length -= chunk;
+        }
+    }
+    ch->prdt[prds - 1].flags = ATA_PRD_EOT;
+}
+
+// blk_queue start routine, issues the request's command. Completion is
+// reported from ata_service once the device interrupts.
+int ata_start(blk_queue *q, blk_request *req) {
+    ata_channel *ch = q->priv;
+    ata_device *d = req->dev->priv;
+    uint16_t bus = ch->bus;
+
+    ch->active = req;
+    ata_set_device(bus, d->dev);
+
+    if (ch->bmide) {
+        uint8_t direction = req->write ? 0 : ATA_BM_COMMAND_READ;
+        ata_build_prdt(ch, req);
+        io_out8(ATA_BM_COMMAND(ch->bmide), direction);
+        io_out32(ATA_BM_PRDT(ch->bmide), MEMORY_PHYS(ch->prdt));
+        // error and interrupt bits are cleared by writing 1s.
+        io_out8(ATA_BM_STATUS(ch->bmide),
+                ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+        ata_command(bus, req->lba, req->sectors,
+                    req->write ? ATA_COMMAND_WRITE_DMA_EXT
+                               : ATA_COMMAND_READ_DMA_EXT);
+        io_out8(ATA_BM_COMMAND(ch->bmide), direction | ATA_BM_COMMAND_START);
+        return 1;
+    }
+
+    ch->cursor.segs = req->segs;
+    ch->cursor.index = 0;
+    ch->cursor.offset = 0;
+    ch->pio_done = 0;
+    ata_command(bus, req->lba, req->sectors,
+                req->write ? ATA_COMMAND_WRITE_EXT : ATA_COMMAND_READ_EXT);
+
+    // a PIO write raises no interrupt until the first sector is sent.
+    if (req->write) {
+        if (!ata_wait_or_error(bus)) {
+            ch->active = 0;
+            return 0;
+        }
+        ata_pio_sector(bus, &ch->cursor, 1);
+        ch->pio_done = 1;
+    }
+    return 1;
+}
+
+void ata_complete(ata_channel *ch, int ok) {
+    blk_request *req = ch->active;
+    ch->active = 0;
+    blk_queue_complete(&ch->queue, req, ok);
+}
+
+// Advance the channel's active request, called from its IRQ handler or, when
+// interrupts are disabled, polled by blk_wait.
+//
+// The device state rather than the interrupt itself decides what happens, so
+// calling it with nothing to do (a poll, or an IRQ which was already handled
+// by polling) is harmless.
+void ata_service(ata_channel *ch) {
+    uint16_t bus = ch->bus;
+    blk_request *req = ch->active;
+    ata_status s;
+
+    if (!req) {
+        // acknowledge a stray interrupt.
+        ata_get_status(bus);
+        return;
+    }
+
+    if (ch->bmide) {
+        uint8_t bm = io_ins8(ATA_BM_STATUS(ch->bmide));
+        if (!(bm & (ATA_BM_STATUS_IRQ | ATA_BM_STATUS_ERROR))) {
+            return;
+        }
+        io_out8(ATA_BM_COMMAND(ch->bmide), req->write ? 0 : ATA_BM_COMMAND_READ);
+        s = ata_get_status(bus);
+        int ok = !(bm & ATA_BM_STATUS_ERROR) && !s.err_chk && !s.df_se;
+        if (ok && req->write) {
+            ok = ata_flush(bus);
+        }
+        // drop the interrupt raised by the flush before the next request.
+        io_out8(ATA_BM_STATUS(ch->bmide),
+                ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+        ata_complete(ch, ok);
+        return;
+    }
+
+    s.i = io_ins8(ATA_PORT_CTRL_ALTSTATUS_RESET(bus));
+    if (s.bsy) {
+        return;
+    }
+    if (s.err_chk || s.df_se) {
+        ata_get_status(bus);
+        ata_complete(ch, 0);
+        return;
+    }
+
+    if (ch->pio_done < req->sectors) {
+        if (!s.drq) {
+            return;
+        }
+        ata_get_status(bus);
+        ata_pio_sector(bus, &ch->cursor, req->write);
+        ch->pio_done++;
+        if (req->write || ch->pio_done < req->sectors) {
+            return;
+        }
+        ata_complete(ch, 1);
+        return;
+    }
+
+    // every sector of a write was sent, the device is done with it.
+    if (req->write && !s.drq) {
+        ata_get_status(bus);
+        ata_complete(ch, ata_flush(bus));
+    }
+}
+
+void ata_poll(blk_queue *q) { ata_service(q->priv); }
+
+// Shared line handler, ata_service is harmless when the channel did not
+// interrupt.
+void ata_irq(void *ctx) { ata_service(ctx); }
+
+// Validate a single buffer request and describe it as one segment.
+ata_device *ata_buffer_segment(uint16_t bus, uint8_t dev, uint64_t start_lba,
+                               uint64_t count, const void *buffer,
+                               blk_segment *seg) {
     ata_device *device = ata_get_device(bus, dev);
     if (!device || device->present == 0) {
         return 0;
@@ -139,58 +351,98 @@ int ata_read_sectors(uint16_t bus, uint8_t dev, uint64_t start_lba,
         return 0;
     }
 
-    ata_set_device(bus, dev);
-
-    ata_status s = {0};
-    while (count > 0) {
-        uint64_t read_count = count;
-
-        if (count > ATA_SECTOR_MAX_COUNT) {
-            // zero means read max sector count of 65,536 sectors.
-            read_count = 0;
-        }
-
-        // double writes to registers are used for READ EXT command.
-        // multi-bytes are written as high bits first, low bits last.
-        io_out8(ATA_PORT_SECTOR_COUNT(bus), ATA_SECTOR_COUNT_ONE(read_count));
-        io_out8(ATA_PORT_SECTOR_COUNT(bus), ATA_SECTOR_COUNT_TWO(read_count));
-
-        if (!read_count) {
-            read_count = ATA_SECTOR_MAX_COUNT;
-        }
+    seg->page = MEMORY_PHYS(buffer);
+    seg->offset = 0;
+    seg->length = count * ATA_SECTOR_SIZE;
+    return device;
+}
 
-        io_out8(ATA_PORT_LBA_LOW(bus), ATA_LBA_LOW_ONE(start_lba));
-        io_out8(ATA_PORT_LBA_LOW(bus), ATA_LBA_LOW_TWO(start_lba));
-        io_out8(ATA_PORT_LBA_MID(bus), ATA_LBA_MID_ONE(start_lba));
-        io_out8(ATA_PORT_LBA_MID(bus), ATA_LBA_MID_TWO(start_lba));
-        io_out8(ATA_PORT_LBA_HIGH(bus), ATA_LBA_HIGH_ONE(start_lba));
-        io_out8(ATA_PORT_LBA_HIGH(bus), ATA_LBA_HIGH_TWO(start_lba));
+// Use 48-bit LBA and READ EXT (or READ DMA EXT) command semantics to read the
+// requested sectors
+int ata_read_sectors(uint16_t bus, uint8_t dev, uint64_t start_lba,
+                     uint64_t count, uint16_t buffer[]) {
+    blk_segment seg;
+    ata_device *device =
+        ata_buffer_segment(bus, dev, start_lba, count, buffer, &seg);
+    if (!device) {
+        return 0;
+    }
+    return blk_readv(&device->blk, start_lba, &seg, 1);
+}
 
-        io_out8(ATA_PORT_COMMAND_STATUS(bus), ATA_COMMAND_READ_EXT);
+int ata_write_sectors(uint16_t bus, uint8_t dev, uint64_t start_lba,
+                      uint64_t count, const uint16_t buffer[]) {
+    blk_segment seg;
+    ata_device *device =
+        ata_buffer_segment(bus, dev, start_lba, count, buffer, &seg);
+    if (!device) {
+        return 0;
+    }
+    return blk_writev(&device->blk, start_lba, &seg, 1);
+}
 
-        for (uint64_t i = 0; i < read_count; i++) {
-            if (!ata_wait_or_error(bus)) {
-                return 0;
-            }
+// Look for the PCI IDE controller's bus master function, BAR4 holds the I/O
+// base of both channels' DMA engines.
+void ata_probe_dma() {
+    pci_device pci;
+    if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0, &pci)) {
+        return;
+    }
+    // prog_if bit 7 advertises bus mastering, BAR4 must be an I/O BAR.
+    if (!(pci.prog_if & 0x80) || !(pci.bar[4] & PCI_BAR_IO_F)) {
+        return;
+    }
 
-            for (int j = 0; j < 256; j++) {
-                uint16_t data = io_ins16(ATA_PORT_DATA(bus));
-                *buffer++ = data;
-            }
-            count -= 1;
+    uint16_t base = pci.bar[4] & PCI_BAR_IO_MASK;
+    for (uint32_t i = 0; i < 2; i++) {
+        ata_prd *prdt = heap_zalloc(ATA_PRD_MAX * sizeof(ata_prd));
+        if (!prdt) {
+            return;
         }
-
-        start_lba += read_count;
+        channels[i].prdt = prdt;
+        channels[i].bmide = base + i * ATA_BM_CHANNEL_STRIDE;
     }
-    return 0;
+    pci_enable(&pci);
 }
 
 int ata_init() {
+    memset(channels, 0, sizeof(channels));
+
     if (!ata_probe_devices(ATA_BUS_1)) {
         return 0;
     }
     if (!ata_probe_devices(ATA_BUS_2)) {
         return 0;
     }
-    return 0;
+
+    ata_probe_dma();
+
+    // each channel gets its own queue and IRQ, so both buses work on their
+    // requests at the same time.
+    for (uint32_t i = 0; i < 2; i++) {
+        ata_channel *ch = &channels[i];
+        ch->bus = i ? ATA_BUS_2 : ATA_BUS_1;
+        blk_queue_init(&ch->queue, 1, ATA_SECTOR_MAX_COUNT, ATA_PRD_MAX / 2,
+                       ATA_PRD_MAX_BYTES, ata_start, ata_poll, ch);
+    }
+    pic_irq_register(ATA_IRQ_PRIMARY, ata_irq, &channels[0]);
+    pic_irq_register(ATA_IRQ_SECONDARY, ata_irq, &channels[1]);
+
+    for (uint32_t i = 0; i < 4; i++) {
+        ata_device *d = &devices[i];
+        d->bus = i < 2 ? ATA_BUS_1 : ATA_BUS_2;
+        d->dev = i & 1;
+        d->blk.name = ata_device_names[i];
+        d->blk.sectors = d->sectors;
+        d->blk.queue = &channels[i / 2].queue;
+        d->blk.priv = d;
+        if (d->present && d->sectors) {
+            blk_register(&d->blk);
+        }
+    }
+
+    // completions are interrupt driven from here on.
+    io_out8(ATA_PORT_CTRL_ALTSTATUS_RESET(ATA_BUS_1), 0);
+    io_out8(ATA_PORT_CTRL_ALTSTATUS_RESET(ATA_BUS_2), 0);
+    return 1;
 }
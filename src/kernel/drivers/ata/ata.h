@@ -1,5 +1,10 @@
+#ifndef ATA_H
+#define ATA_H
+
 #include <stdint.h>
 
+#include "../blk/blk.h"
+
 #define ATA_BUS_1 0x1F0
 #define ATA_BUS_2 0x170
 
@@ -15,8 +20,41 @@
 #define ATA_PORT_DEV_ADDRESS(bus) (bus + 0x207)
 
 #define ATA_COMMAND_READ_EXT 0x24
+#define ATA_COMMAND_READ_DMA_EXT 0x25
+#define ATA_COMMAND_WRITE_EXT 0x34
+#define ATA_COMMAND_WRITE_DMA_EXT 0x35
+#define ATA_COMMAND_READ_LOG_EXT 0x2F
+#define ATA_COMMAND_READ_FPDMA_QUEUED 0x60
+#define ATA_COMMAND_WRITE_FPDMA_QUEUED 0x61
+#define ATA_COMMAND_FLUSH_EXT 0xEA
 #define ATA_COMMAND_IDENTIFY 0xEC
 
+#define ATA_IRQ_PRIMARY 14
+#define ATA_IRQ_SECONDARY 15
+
+// device control register bits
+#define ATA_CTRL_NIEN 0x02
+
+// Bus master IDE registers, relative to the channel's base in BAR4 of the
+// IDE controller (the secondary channel's registers start at +8).
+#define ATA_BM_COMMAND(base) (base)
+#define ATA_BM_STATUS(base) (base + 2)
+#define ATA_BM_PRDT(base) (base + 4)
+#define ATA_BM_CHANNEL_STRIDE 8
+
+#define ATA_BM_COMMAND_START 0x01
+// direction bit, set when the device writes to memory (a disk read).
+#define ATA_BM_COMMAND_READ 0x08
+#define ATA_BM_STATUS_ACTIVE 0x01
+#define ATA_BM_STATUS_ERROR 0x02
+#define ATA_BM_STATUS_IRQ 0x04
+
+// Physical region descriptors may not cross a 64KiB boundary, a byte count
+// of 0 means 64KiB.
+#define ATA_PRD_MAX_BYTES 0x10000
+#define ATA_PRD_EOT 0x8000
+
+#define ATA_SECTOR_SIZE 512
 #define ATA_SECTOR_MAX_COUNT (1 << 16)
 #define ATA_LBA_MAX (1ULL << 48)
 
@@ -30,21 +68,80 @@
 #define ATA_SECTOR_COUNT_ONE(count) ((count >> 8) & 0xFF)
 #define ATA_SECTOR_COUNT_TWO(count) (count & 0xFF)
 
+// native command queuing, word 75 holds the maximum queue depth - 1 and bit 8
+// of word 76 advertises support.
+#define ATA_IDENTIFY_QUEUE_DEPTH (75)
+#define ATA_IDENTIFY_SATA_CAPABILITIES (76)
+#define ATA_IDENTIFY_SATA_NCQ_F (1 << 8)
 #define ATA_IDENTIFY_SECTORS_ONE (100)
 #define ATA_IDENTIFY_SECTORS_TWO (101)
 #define ATA_IDENTIFY_SECTORS_THREE (102)
 #define ATA_IDENTIFY_SECTORS_FOUR (103)
 
+typedef struct ata_prd {
+    uint32_t address;
+    uint16_t bytes;
+    uint16_t flags;
+} __attribute__((packed)) ata_prd;
+
+#define ATA_PRD_MAX (4096 / sizeof(ata_prd))
+
 typedef struct ata_device {
     uint32_t present : 1;
     uint32_t : 31;
     uint64_t sectors;
+    uint16_t bus;
+    uint8_t dev;
+    blk_device blk;
 } ata_device;
 
+// Walks the segments of a vectored request one sector at a time.
+typedef struct ata_cursor {
+    const blk_segment *segs;
+    uint32_t index;
+    uint32_t offset;
+} ata_cursor;
+
+// Per bus state, `bmide` is 0 when no bus master DMA engine was found and
+// transfers fall back to PIO, driven one sector per interrupt through
+// `cursor`.
+typedef struct ata_channel {
+    uint16_t bus;
+    uint16_t bmide;
+    ata_prd *prdt;
+    blk_queue queue;
+    // the channel runs one command at a time.
+    blk_request *active;
+    ata_cursor cursor;
+    uint32_t pio_done;
+} ata_channel;
+
 // Initialize the ATA subsystem.
 //
-// Probe the controller to identity which disks are present.
+// Probe the controller to identity which disks are present, look for a PCI
+// bus master IDE function to use for DMA and register every present disk as
+// a block device named "ata0" (primary master) to "ata3" (secondary slave).
+//
+// Each bus is serviced by its own request queue, completed from the bus's
+// IRQ.
 int ata_init();
 
+// Return the device for the given bus and drive, or 0 if either is invalid.
+ata_device *ata_get_device(uint16_t bus, uint8_t dev);
+
+// Read `count` sectors starting at `start_lba` into `buffer`.
+//
+// The read goes through the bus's request queue, by bus master DMA when
+// available and PIO otherwise.
+//
+// Returns 1 on success and 0 if the device is not present, the range exceeds
+// the device or the device reports an error.
 int ata_read_sectors(uint16_t bus, uint8_t dev, uint64_t start_lba,
                      uint64_t count, uint16_t buffer[]);
+
+// Write `count` sectors from `buffer` starting at `start_lba` and flush the
+// device's write cache.
+int ata_write_sectors(uint16_t bus, uint8_t dev, uint64_t start_lba,
+                      uint64_t count, const uint16_t buffer[]);
+
+#endif  // ATA_H
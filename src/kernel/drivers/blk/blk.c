@@ -0,0 +1,432 @@
+#include "blk.h"
+
+#include <stdint.h>
+
+#include "../../cpu/cpu.h"
+#include "../../idle/idle.h"
+#include "../../memory/memory.h"
+#include "../serial/serial.h"
+
+blk_device *blk_devices[BLK_MAX_DEVICES];
+uint32_t blk_device_count;
+
+blk_request blk_requests[BLK_MAX_REQUESTS];
+blk_request *blk_free_requests;
+
+void blk_init() {
+    memset(blk_requests, 0, sizeof(blk_requests));
+    blk_free_requests = 0;
+    for (uint32_t i = 0; i < BLK_MAX_REQUESTS; i++) {
+        blk_requests[i].next = blk_free_requests;
+        blk_free_requests = &blk_requests[i];
+    }
+}
+
+int blk_register(blk_device *dev) {
+    if (blk_device_count >= BLK_MAX_DEVICES) {
+        return 0;
+    }
+    dev->id = blk_device_count;
+    blk_devices[blk_device_count++] = dev;
+    return 1;
+}
+
+blk_device *blk_find(const char *name) {
+    for (uint32_t i = 0; i < blk_device_count; i++) {
+        const char *a = blk_devices[i]->name;
+        const char *b = name;
+        while (*a && *a == *b) {
+            a++;
+            b++;
+        }
+        if (*a == *b) {
+            return blk_devices[i];
+        }
+    }
+    return 0;
+}
+
+// Validate a vectored request, returns the number of sectors it covers or 0
+// if it is malformed or exceeds the device.
+uint64_t blk_check(blk_device *dev, uint64_t lba, const blk_segment *segs,
+                   uint32_t count) {
+    if (!dev || !segs || !count) {
+        return 0;
+    }
+    uint64_t sectors = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!segs[i].length || segs[i].length % BLK_SECTOR_SIZE != 0) {
+            return 0;
+        }
+        sectors += segs[i].length / BLK_SECTOR_SIZE;
+    }
+    if (lba >= dev->sectors || sectors > dev->sectors - lba) {
+        return 0;
+    }
+    return sectors;
+}
+
+void blk_queue_init(blk_queue *q, uint32_t depth_limit, uint32_t max_sectors,
+                    uint32_t max_segments, uint32_t max_segment_bytes,
+                    int (*start)(blk_queue *, blk_request *),
+                    void (*poll)(blk_queue *), void *priv) {
+    memset(q, 0, sizeof(blk_queue));
+    q->depth_limit = depth_limit;
+    if (max_segments > BLK_REQUEST_MAX_SEGMENTS) {
+        max_segments = BLK_REQUEST_MAX_SEGMENTS;
+    }
+    q->max_sectors = max_sectors;
+    q->max_segments = max_segments;
+    q->max_segment_bytes = max_segment_bytes;
+    q->start = start;
+    q->poll = poll;
+    q->priv = priv;
+}
+
+blk_queue_stats *blk_get_stats(blk_device *dev) {
+    if (!dev || !dev->queue) {
+        return 0;
+    }
+    return &dev->queue->stats;
+}
+
+void blk_dump() {
+    for (uint32_t i = 0; i < blk_device_count; i++) {
+        blk_queue *q = blk_devices[i]->queue;
+        if (!q) {
+            continue;
+        }
+        // devices sharing a channel share its queue, report it once.
+        uint32_t j = 0;
+        while (j < i && blk_devices[j]->queue != q) {
+            j++;
+        }
+        if (j < i) {
+            continue;
+        }
+
+        blk_queue_stats *s = blk_get_stats(blk_devices[i]);
+        serial_write_str("blk: dev=");
+        serial_write_str(blk_devices[i]->name);
+        serial_write_str(" submitted=");
+        serial_write_dec(s->submitted);
+        serial_write_str(" merged=");
+        serial_write_dec(s->merged);
+        serial_write_str(" dispatched=");
+        serial_write_dec(s->dispatched);
+        serial_write_str(" completed=");
+        serial_write_dec(s->completed);
+        serial_write_str(" errors=");
+        serial_write_dec(s->errors);
+        serial_write_str(" depth_avg=");
+        serial_write_dec(cpu_div64(s->depth_sum, s->submitted));
+        serial_write_str(" depth_max=");
+        serial_write_dec(s->max_depth);
+        serial_write_str(" latency_avg=");
+        serial_write_dec(cpu_div64(s->latency_sum, s->completed));
+        serial_write_str(" latency_max=");
+        serial_write_dec(s->latency_max);
+        serial_write_str("\n");
+    }
+}
+
+// Take a request from the pool, or return 0 when every request is in use.
+blk_request *blk_alloc_request() {
+    uint32_t flags = cpu_irq_save();
+    blk_request *req = blk_free_requests;
+    if (req) {
+        blk_free_requests = req->next;
+    }
+    cpu_irq_restore(flags);
+
+    if (req) {
+        memset(req, 0, sizeof(blk_request));
+    }
+    return req;
+}
+
+void blk_free_request(blk_request *req) {
+    uint32_t flags = cpu_irq_save();
+    req->next = blk_free_requests;
+    blk_free_requests = req;
+    cpu_irq_restore(flags);
+}
+
+// Fold `req` into a pending request it directly follows or precedes.
+int blk_try_merge(blk_queue *q, blk_request *req) {
+    for (blk_request *p = q->pending; p; p = p->next) {
+        if (p->dev != req->dev || p->write != req->write ||
+            p->sectors + req->sectors > q->max_sectors ||
+            p->seg_count + req->seg_count > q->max_segments) {
+            continue;
+        }
+
+        if (p->lba + p->sectors == req->lba) {
+            memcpy(&p->segs[p->seg_count], req->segs,
+                   req->seg_count * sizeof(blk_segment));
+        } else if (req->lba + req->sectors == p->lba) {
+            for (uint32_t i = p->seg_count; i > 0; i--) {
+                p->segs[i - 1 + req->seg_count] = p->segs[i - 1];
+            }
+            memcpy(p->segs, req->segs, req->seg_count * sizeof(blk_segment));
+            p->lba = req->lba;
+        } else {
+            continue;
+        }
+
+        p->seg_count += req->seg_count;
+        p->sectors += req->sectors;
+        req->merged = p->merged;
+        p->merged = req;
+        q->stats.merged++;
+        return 1;
+    }
+    return 0;
+}
+
+int blk_request_before(blk_request *a, uint32_t dev, uint64_t lba) {
+    return a->dev->id < dev || (a->dev->id == dev && a->lba < lba);
+}
+
+void blk_insert_sorted(blk_queue *q, blk_request *req) {
+    blk_request **p = &q->pending;
+    while (*p && blk_request_before(*p, req->dev->id, req->lba)) {
+        p = &(*p)->next;
+    }
+    req->next = *p;
+    *p = req;
+}
+
+// C-LOOK, take the first request at or past the elevator position, wrapping
+// around to the lowest one at the end of a sweep.
+blk_request *blk_next_request(blk_queue *q) {
+    blk_request **p = &q->pending;
+    while (*p && blk_request_before(*p, q->head_dev, q->head_lba)) {
+        p = &(*p)->next;
+    }
+    if (!*p) {
+        p = &q->pending;
+    }
+    blk_request *req = *p;
+    *p = req->next;
+    req->next = 0;
+    return req;
+}
+
+void blk_finish(blk_queue *q, blk_request *req, int ok) {
+    uint64_t now = cpu_rdtsc();
+    while (req) {
+        blk_request *next = req->merged;
+
+        uint64_t latency = now - req->submitted;
+        q->stats.latency_sum += latency;
+        if (latency > q->stats.latency_max) {
+            q->stats.latency_max = latency;
+        }
+        q->stats.completed++;
+        q->stats.depth--;
+        if (!ok) {
+            q->stats.errors++;
+        }
+
+        req->ok = ok;
+        if (req->callback) {
+            req->callback(req, req->ctx);
+            blk_free_request(req);
+        } else {
+            req->done = 1;
+        }
+        req = next;
+    }
+}
+
+void blk_dispatch(blk_queue *q) {
+    uint32_t started = 0;
+    while (q->inflight < q->depth_limit && q->pending) {
+        blk_request *req = blk_next_request(q);
+        q->head_dev = req->dev->id;
+        q->head_lba = req->lba + req->sectors;
+        q->stats.dispatched++;
+        q->inflight++;
+        if (!q->start(q, req)) {
+            q->inflight--;
+            blk_finish(q, req, 0);
+            continue;
+        }
+        started++;
+    }
+    if (started && q->commit) {
+        q->commit(q);
+    }
+}
+
+void blk_queue_complete(blk_queue *q, blk_request *req, int ok) {
+    if (!req) {
+        return;
+    }
+    q->inflight--;
+    blk_finish(q, req, ok);
+    blk_dispatch(q);
+}
+
+blk_request *blk_submit(blk_device *dev, uint64_t lba, const blk_segment *segs,
+                        uint32_t count, int write, blk_done_fn callback,
+                        void *ctx) {
+    uint64_t sectors = blk_check(dev, lba, segs, count);
+    if (!sectors || !dev->queue) {
+        return 0;
+    }
+    blk_queue *q = dev->queue;
+    if (count > q->max_segments || sectors > q->max_sectors) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (segs[i].length > q->max_segment_bytes) {
+            return 0;
+        }
+    }
+
+    blk_request *req = blk_alloc_request();
+    if (!req) {
+        return 0;
+    }
+    req->dev = dev;
+    req->lba = lba;
+    req->sectors = sectors;
+    req->write = write != 0;
+    memcpy(req->segs, segs, count * sizeof(blk_segment));
+    req->seg_count = count;
+    req->callback = callback;
+    req->ctx = ctx;
+    req->submitted = cpu_rdtsc();
+
+    uint32_t flags = cpu_irq_save();
+    q->stats.submitted++;
+    q->stats.depth++;
+    q->stats.depth_sum += q->stats.depth;
+    if (q->stats.depth > q->stats.max_depth) {
+        q->stats.max_depth = q->stats.depth;
+    }
+    if (!blk_try_merge(q, req)) {
+        blk_insert_sorted(q, req);
+    }
+    blk_dispatch(q);
+    cpu_irq_restore(flags);
+
+    return req;
+}
+
+int blk_wait(blk_request *req) {
+    blk_queue *q = req->dev->queue;
+    uint32_t flags = cpu_irq_save();
+    while (!req->done) {
+        if (flags & CPU_EFLAGS_IF) {
+            // halt until the completion interrupt, done is checked with
+            // interrupts disabled so it cannot arrive unseen.
+            idle_wait();
+        } else {
+            // nothing will interrupt us, drive the hardware ourselves.
+            q->poll(q);
+        }
+    }
+    cpu_irq_restore(flags);
+    int ok = req->ok;
+    blk_free_request(req);
+    return ok;
+}
+
+// Split a vectored transfer into requests within the queue's limits, keeping
+// up to BLK_SYNC_BATCH of them in flight, and wait for all of them.
+int blk_transfer(blk_device *dev, uint64_t lba, const blk_segment *segs,
+                 uint32_t count, int write) {
+    if (!blk_check(dev, lba, segs, count)) {
+        return 0;
+    }
+    if (!dev->queue) {
+        blk_transfer_fn fn = write ? dev->writev : dev->readv;
+        return fn ? fn(dev, lba, segs, count) : 0;
+    }
+
+    blk_queue *q = dev->queue;
+    blk_segment chunk[BLK_REQUEST_MAX_SEGMENTS];
+    blk_request *inflight[BLK_SYNC_BATCH];
+    uint32_t n = 0;
+    uint32_t i = 0;
+    uint32_t offset = 0;
+    int ok = 1;
+
+    while (i < count) {
+        uint32_t nsegs = 0;
+        uint32_t sectors = 0;
+        while (i < count && nsegs < q->max_segments &&
+               sectors < q->max_sectors) {
+            uint32_t length = segs[i].length - offset;
+            if (length > q->max_segment_bytes) {
+                length = q->max_segment_bytes;
+            }
+            if (length > (q->max_sectors - sectors) * BLK_SECTOR_SIZE) {
+                length = (q->max_sectors - sectors) * BLK_SECTOR_SIZE;
+            }
+            chunk[nsegs].page = segs[i].page;
+            chunk[nsegs].offset = segs[i].offset + offset;
+            chunk[nsegs].length = length;
+            nsegs++;
+            sectors += length / BLK_SECTOR_SIZE;
+
+            offset += length;
+            if (offset == segs[i].length) {
+                i++;
+                offset = 0;
+            }
+        }
+
+        blk_request *req = blk_submit(dev, lba, chunk, nsegs, write, 0, 0);
+        if (!req && n) {
+            // the request pool is exhausted, reap our batch and retry.
+            for (uint32_t j = 0; j < n; j++) {
+                ok &= blk_wait(inflight[j]);
+            }
+            n = 0;
+            req = blk_submit(dev, lba, chunk, nsegs, write, 0, 0);
+        }
+        if (!req) {
+            ok = 0;
+            break;
+        }
+        lba += sectors;
+
+        inflight[n++] = req;
+        if (n == BLK_SYNC_BATCH) {
+            for (uint32_t j = 0; j < n; j++) {
+                ok &= blk_wait(inflight[j]);
+            }
+            n = 0;
+        }
+    }
+
+    for (uint32_t j = 0; j < n; j++) {
+        ok &= blk_wait(inflight[j]);
+    }
+    return ok;
+}
+
+int blk_readv(blk_device *dev, uint64_t lba, const blk_segment *segs,
+              uint32_t count) {
+    return blk_transfer(dev, lba, segs, count, 0);
+}
+
+int blk_writev(blk_device *dev, uint64_t lba, const blk_segment *segs,
+               uint32_t count) {
+    return blk_transfer(dev, lba, segs, count, 1);
+}
+
+int blk_read(blk_device *dev, uint64_t lba, uint32_t sectors, void *buffer) {
+    blk_segment seg = {MEMORY_PHYS(buffer), 0, sectors * BLK_SECTOR_SIZE};
+    return blk_readv(dev, lba, &seg, 1);
+}
+
+int blk_write(blk_device *dev, uint64_t lba, uint32_t sectors,
+              const void *buffer) {
+    blk_segment seg = {MEMORY_PHYS(buffer), 0, sectors * BLK_SECTOR_SIZE};
+    return blk_writev(dev, lba, &seg, 1);
+}
@@ -0,0 +1,181 @@
+#ifndef BLK_H
+#define BLK_H
+
+#include <stdint.h>
+
+#define BLK_SECTOR_SIZE 512
+#define BLK_MAX_DEVICES 16
+
+// Size of the request pool shared by all queues.
+#define BLK_MAX_REQUESTS 64
+// Maximum segments carried by one (possibly merged) request.
+#define BLK_REQUEST_MAX_SEGMENTS 128
+// Requests a synchronous blk_readv/blk_writev keeps in flight at once.
+#define BLK_SYNC_BATCH 8
+
+// One piece of a vectored transfer, `length` bytes at `offset` into the
+// physically contiguous memory starting at physical address `page`.
+//
+// `length` must be a non-zero multiple of BLK_SECTOR_SIZE, so no sector is
+// ever split between two segments.
+typedef struct blk_segment {
+    uint32_t page;
+    uint32_t offset;
+    uint32_t length;
+} blk_segment;
+
+typedef struct blk_device blk_device;
+typedef struct blk_request blk_request;
+typedef struct blk_queue blk_queue;
+
+// Driver transfer routine, moves the sectors described by `segs` starting at
+// `lba`, returns 1 on success and 0 on error.
+typedef int (*blk_transfer_fn)(blk_device *dev, uint64_t lba,
+                               const blk_segment *segs, uint32_t count);
+
+// Completion callback, called from interrupt context.
+typedef void (*blk_done_fn)(blk_request *req, void *ctx);
+
+struct blk_device {
+    // index in the block device registry, assigned by blk_register.
+    uint32_t id;
+    const char *name;
+    uint64_t sectors;
+    // request queue servicing the device, devices sharing a channel share a
+    // queue. When 0, transfers call readv/writev synchronously instead.
+    blk_queue *queue;
+    blk_transfer_fn readv;
+    blk_transfer_fn writev;
+    void *priv;
+};
+
+struct blk_request {
+    blk_device *dev;
+    uint64_t lba;
+    uint32_t sectors;
+    uint8_t write;
+    volatile uint8_t done;
+    volatile uint8_t ok;
+    blk_segment segs[BLK_REQUEST_MAX_SEGMENTS];
+    uint32_t seg_count;
+    blk_done_fn callback;
+    void *ctx;
+    uint64_t submitted;
+    // next request in the queue's pending list or the free list.
+    blk_request *next;
+    // requests merged into this one, completed along with it.
+    blk_request *merged;
+};
+
+typedef struct blk_queue_stats {
+    // requests handed to blk_submit.
+    uint32_t submitted;
+    // requests folded into an already queued adjacent request.
+    uint32_t merged;
+    // commands issued to the device.
+    uint32_t dispatched;
+    uint32_t completed;
+    uint32_t errors;
+    // requests currently queued or in flight, and the highest seen.
+    uint32_t depth;
+    uint32_t max_depth;
+    // queue depth sampled at every submit, divide by `submitted` for the
+    // average.
+    uint64_t depth_sum;
+    // TSC cycles from submit to completion, divide by `completed` for the
+    // average.
+    uint64_t latency_sum;
+    uint64_t latency_max;
+} blk_queue_stats;
+
+// A per channel request queue.
+//
+// Pending requests are kept sorted by (device, LBA) and dispatched in one
+// direction sweeps (C-LOOK), adjacent requests in the same direction are
+// merged into one command. Up to `depth_limit` requests are handed to the
+// driver's `start` at once, the driver reports each completion, usually from
+// its IRQ handler, with blk_queue_complete.
+struct blk_queue {
+    blk_request *pending;
+    // requests started and not yet completed.
+    uint32_t inflight;
+    uint32_t depth_limit;
+    // elevator position, the sector following the last dispatched request.
+    uint32_t head_dev;
+    uint64_t head_lba;
+    // limits of a single command.
+    uint32_t max_sectors;
+    uint32_t max_segments;
+    uint32_t max_segment_bytes;
+    // start the hardware on `req`, returns 0 if it could not be started.
+    int (*start)(blk_queue *q, blk_request *req);
+    // optional, called once after a dispatch round started requests, lets
+    // drivers batch their doorbell writes.
+    void (*commit)(blk_queue *q);
+    // service the hardware without interrupts, used while waiting with
+    // interrupts disabled (e.g. from the page fault handler).
+    void (*poll)(blk_queue *q);
+    void *priv;
+    blk_queue_stats stats;
+};
+
+// Initialize the request pool, must be called before any driver registers.
+void blk_init();
+
+// Add a device to the registry, returns 0 if the registry is full.
+int blk_register(blk_device *dev);
+
+// Find a registered device by name, e.g. "ata2".
+blk_device *blk_find(const char *name);
+
+void blk_queue_init(blk_queue *q, uint32_t depth_limit, uint32_t max_sectors,
+                    uint32_t max_segments, uint32_t max_segment_bytes,
+                    int (*start)(blk_queue *, blk_request *),
+                    void (*poll)(blk_queue *), void *priv);
+
+// Complete a started request (and any merged into it) and dispatch more,
+// called by drivers with interrupts disabled.
+void blk_queue_complete(blk_queue *q, blk_request *req, int ok);
+
+// Queue an asynchronous transfer, the request must fit the queue's limits.
+//
+// With a `callback` the request is released once the callback returns,
+// without one the caller must reap it with blk_wait. Returns 0 if the
+// request is malformed, the device has no queue or every request of the pool
+// is in use, the caller then reaps its own requests before retrying.
+blk_request *blk_submit(blk_device *dev, uint64_t lba, const blk_segment *segs,
+                        uint32_t count, int write, blk_done_fn callback,
+                        void *ctx);
+
+// Wait for a request submitted without a callback, release it and return 1
+// if it succeeded.
+int blk_wait(blk_request *req);
+
+// Queue statistics of the device, or 0 if it has no queue.
+blk_queue_stats *blk_get_stats(blk_device *dev);
+
+// Print the statistics of every queue over serial, one line per queue named
+// after its first device, latencies in TSC cycles:
+//
+//   blk: dev=<name> submitted=<n> merged=<n> dispatched=<n> completed=<n>
+//        errors=<n> depth_avg=<n> depth_max=<n> latency_avg=<n>
+//        latency_max=<n>
+void blk_dump();
+
+// Read the sectors starting at `lba` directly into the segments, in order.
+//
+// Requests larger than the queue's limits are split and kept in flight
+// together, so the elevator can order and merge them.
+int blk_readv(blk_device *dev, uint64_t lba, const blk_segment *segs,
+              uint32_t count);
+
+// Write the segments, in order, to the sectors starting at `lba`.
+int blk_writev(blk_device *dev, uint64_t lba, const blk_segment *segs,
+               uint32_t count);
+
+// Single segment convenience wrappers over a kernel virtual buffer.
+int blk_read(blk_device *dev, uint64_t lba, uint32_t sectors, void *buffer);
+int blk_write(blk_device *dev, uint64_t lba, uint32_t sectors,
+              const void *buffer);
+
+#endif  // BLK_H
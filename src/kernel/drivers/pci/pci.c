@@ -0,0 +1,121 @@
+#include "pci.h"
+
+#include <stdint.h>
+
+#include "../../io/io.h"
+
+// Configuration mechanism #1, the address selects a dword of the function's
+// configuration space which is then accessed through the data port.
+uint32_t pci_config_address(uint8_t bus, uint8_t slot, uint8_t func,
+                            uint8_t offset) {
+    return 0x80000000 | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) |
+           ((uint32_t)func << 8) | (offset & 0xFC);
+}
+
+uint32_t pci_read32(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    io_out32(PCI_CONFIG_ADDRESS, pci_config_address(bus, slot, func, offset));
+    return io_ins32(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_config_read32(const pci_device *dev, uint8_t offset) {
+    return pci_read32(dev->bus, dev->slot, dev->func, offset);
+}
+
+uint16_t pci_config_read16(const pci_device *dev, uint8_t offset) {
+    return pci_config_read32(dev, offset) >> ((offset & 2) * 8);
+}
+
+uint8_t pci_config_read8(const pci_device *dev, uint8_t offset) {
+    return pci_config_read32(dev, offset) >> ((offset & 3) * 8);
+}
+
+void pci_config_write32(const pci_device *dev, uint8_t offset,
+                        uint32_t value) {
+    io_out32(PCI_CONFIG_ADDRESS,
+             pci_config_address(dev->bus, dev->slot, dev->func, offset));
+    io_out32(PCI_CONFIG_DATA, value);
+}
+
+void pci_config_write16(const pci_device *dev, uint8_t offset,
+                        uint16_t value) {
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t dword = pci_config_read32(dev, offset);
+    dword = (dword & ~(0xFFFF << shift)) | ((uint32_t)value << shift);
+    pci_config_write32(dev, offset, dword);
+}
+
+void pci_fill_device(uint8_t bus, uint8_t slot, uint8_t func,
+                     pci_device *dev) {
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+    dev->vendor_id = pci_config_read16(dev, PCI_VENDOR_ID);
+    dev->device_id = pci_config_read16(dev, PCI_DEVICE_ID);
+    dev->class_code = pci_config_read8(dev, PCI_CLASS);
+    dev->subclass = pci_config_read8(dev, PCI_SUBCLASS);
+    dev->prog_if = pci_config_read8(dev, PCI_PROG_IF);
+    dev->irq_line = pci_config_read8(dev, PCI_INTERRUPT_LINE);
+    for (uint8_t i = 0; i < 6; i++) {
+        dev->bar[i] = pci_config_read32(dev, PCI_BAR0 + i * 4);
+    }
+}
+
+// Walk every function on every bus, returning the `n`th one accepted by
+// `match`.
+int pci_scan(int (*match)(const pci_device *, uint32_t, uint32_t),
+             uint32_t a, uint32_t b, uint32_t n, pci_device *out) {
+    for (uint32_t bus = 0; bus < PCI_MAX_BUS; bus++) {
+        for (uint8_t slot = 0; slot < PCI_MAX_SLOT; slot++) {
+            for (uint8_t func = 0; func < PCI_MAX_FUNC; func++) {
+                uint32_t id = pci_read32(bus, slot, func, PCI_VENDOR_ID);
+                if ((id & 0xFFFF) == 0xFFFF) {
+                    if (func == 0) {
+                        break;
+                    }
+                    continue;
+                }
+
+                pci_device dev;
+                pci_fill_device(bus, slot, func, &dev);
+                if (match(&dev, a, b) && n-- == 0) {
+                    *out = dev;
+                    return 1;
+                }
+
+                if (func == 0 &&
+                    !(pci_config_read8(&dev, PCI_HEADER_TYPE) &
+                      PCI_HEADER_MULTI_FUNCTION_F)) {
+                    break;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int pci_match_class(const pci_device *dev, uint32_t class_code,
+                    uint32_t subclass) {
+    return dev->class_code == class_code && dev->subclass == subclass;
+}
+
+int pci_match_device(const pci_device *dev, uint32_t vendor_id,
+                     uint32_t device_id) {
+    return dev->vendor_id == vendor_id && dev->device_id == device_id;
+}
+
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint32_t n,
+                   pci_device *out) {
+    return pci_scan(pci_match_class, class_code, subclass, n, out);
+}
+
+int pci_find_device(uint16_t vendor_id, uint16_t device_id, uint32_t n,
+                    pci_device *out) {
+    return pci_scan(pci_match_device, vendor_id, device_id, n, out);
+}
+
+void pci_enable(const pci_device *dev) {
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+    command |=
+        PCI_COMMAND_IO_F | PCI_COMMAND_MEMORY_F | PCI_COMMAND_BUS_MASTER_F;
+    pci_config_write16(dev, PCI_COMMAND, command);
+}
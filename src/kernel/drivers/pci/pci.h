@@ -0,0 +1,72 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+
+#define PCI_MAX_BUS 256
+#define PCI_MAX_SLOT 32
+#define PCI_MAX_FUNC 8
+
+// configuration space offsets
+#define PCI_VENDOR_ID 0x00
+#define PCI_DEVICE_ID 0x02
+#define PCI_COMMAND 0x04
+#define PCI_STATUS 0x06
+#define PCI_PROG_IF 0x09
+#define PCI_SUBCLASS 0x0A
+#define PCI_CLASS 0x0B
+#define PCI_HEADER_TYPE 0x0E
+#define PCI_BAR0 0x10
+#define PCI_SUBSYSTEM_ID 0x2E
+#define PCI_CAPABILITIES 0x34
+#define PCI_INTERRUPT_LINE 0x3C
+
+#define PCI_COMMAND_IO_F (1 << 0)
+#define PCI_COMMAND_MEMORY_F (1 << 1)
+#define PCI_COMMAND_BUS_MASTER_F (1 << 2)
+
+#define PCI_HEADER_MULTI_FUNCTION_F 0x80
+#define PCI_BAR_IO_F 0x1
+#define PCI_BAR_IO_MASK 0xFFFFFFFC
+#define PCI_BAR_MEM_MASK 0xFFFFFFF0
+
+#define PCI_CLASS_STORAGE 0x01
+#define PCI_SUBCLASS_IDE 0x01
+#define PCI_SUBCLASS_SATA 0x06
+
+typedef struct pci_device {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq_line;
+    uint32_t bar[6];
+} pci_device;
+
+uint32_t pci_config_read32(const pci_device *dev, uint8_t offset);
+uint16_t pci_config_read16(const pci_device *dev, uint8_t offset);
+uint8_t pci_config_read8(const pci_device *dev, uint8_t offset);
+void pci_config_write32(const pci_device *dev, uint8_t offset, uint32_t value);
+void pci_config_write16(const pci_device *dev, uint8_t offset, uint16_t value);
+
+// Find the `n`th (counting from 0) function matching the class and subclass.
+//
+// Returns 1 and fills `out` if found, 0 otherwise.
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint32_t n,
+                   pci_device *out);
+
+// Find the `n`th (counting from 0) function matching the vendor and device.
+int pci_find_device(uint16_t vendor_id, uint16_t device_id, uint32_t n,
+                    pci_device *out);
+
+// Enable I/O, memory space decoding and bus mastering for the function.
+void pci_enable(const pci_device *dev);
+
+#endif  // PCI_H
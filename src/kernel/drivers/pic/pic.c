@@ -1,10 +1,10 @@
 #include "pic.h"
 
+#include "../../cpu/cpu.h"
+#include "../../idt.h"
 #include "../../io/io.h"
 
 #define PIC_INIT_CMD 0x11       // 0b00010001
-#define PIC_MASTER_OFFSET 0x20  // IRQ[0..7] -> INT[0x20..0x27]
-#define PIC_SLAVE_OFFSET 0x28   // IRQ[8..15] -> INT[0x28..0x2F]
 #define PIC_CASCADE 2           // for master, we shift this to get 0x04.
 #define PIC_8086_MODE 0x01
 
@@ -35,3 +35,72 @@ void pic_init() {
     // With the PIC properly initialized now they should be enabled
     asm volatile("sti");
 }
+
+void pic_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        io_out8(PIC_SLAVE_CMD_PORT, PIC_EOI);
+    }
+    io_out8(PIC_MASTER_CMD_PORT, PIC_EOI);
+}
+
+pic_irq_handler pic_irq_handlers[PIC_IRQ_MAX_HANDLERS];
+uint32_t pic_irq_handler_count;
+pic_irq_handler *pic_irq_lines[PIC_IRQ_LINES];
+
+void pic_irq_dispatch(uint8_t irq) {
+    for (pic_irq_handler *h = pic_irq_lines[irq]; h; h = h->next) {
+        h->fn(h->ctx);
+    }
+    pic_eoi(irq);
+}
+
+// One entry point per line, the vector alone tells which line fired.
+#define PIC_IRQ_ENTRY(n)                          \
+    void pic_irq##n() { pic_irq_dispatch(n); }   \
+    idt_handler(pic_handler_irq##n, pic_irq##n);
+
+PIC_IRQ_ENTRY(0)
+PIC_IRQ_ENTRY(1)
+PIC_IRQ_ENTRY(2)
+PIC_IRQ_ENTRY(3)
+PIC_IRQ_ENTRY(4)
+PIC_IRQ_ENTRY(5)
+PIC_IRQ_ENTRY(6)
+PIC_IRQ_ENTRY(7)
+PIC_IRQ_ENTRY(8)
+PIC_IRQ_ENTRY(9)
+PIC_IRQ_ENTRY(10)
+PIC_IRQ_ENTRY(11)
+PIC_IRQ_ENTRY(12)
+PIC_IRQ_ENTRY(13)
+PIC_IRQ_ENTRY(14)
+PIC_IRQ_ENTRY(15)
+
+void *pic_irq_entries[PIC_IRQ_LINES] = {
+    pic_handler_irq0,  pic_handler_irq1,  pic_handler_irq2,
+    pic_handler_irq3,  pic_handler_irq4,  pic_handler_irq5,
+    pic_handler_irq6,  pic_handler_irq7,  pic_handler_irq8,
+    pic_handler_irq9,  pic_handler_irq10, pic_handler_irq11,
+    pic_handler_irq12, pic_handler_irq13, pic_handler_irq14,
+    pic_handler_irq15};
+
+int pic_irq_register(uint8_t irq, pic_irq_fn fn, void *ctx) {
+    if (irq >= PIC_IRQ_LINES || !fn ||
+        pic_irq_handler_count >= PIC_IRQ_MAX_HANDLERS) {
+        return 0;
+    }
+    pic_irq_handler *h = &pic_irq_handlers[pic_irq_handler_count++];
+    h->fn = fn;
+    h->ctx = ctx;
+    h->next = 0;
+
+    uint32_t flags = cpu_irq_save();
+    pic_irq_handler **p = &pic_irq_lines[irq];
+    while (*p) {
+        p = &(*p)->next;
+    }
+    *p = h;
+    idt_set(PIC_IRQ_VECTOR(irq), pic_irq_entries[irq]);
+    cpu_irq_restore(flags);
+    return 1;
+}
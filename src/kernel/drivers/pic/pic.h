@@ -1,6 +1,8 @@
 #ifndef PIC_H
 #define PIC_H
 
+#include <stdint.h>
+
 #define PIC_MASTER_CMD_PORT 0x20
 #define PIC_MASTER_DATA_PORT 0x21
 #define PIC_SLAVE_CMD_PORT 0xA0
@@ -8,6 +10,40 @@
 
 #define PIC_KEYBOARD_IRQ 0x20
 
+#define PIC_MASTER_OFFSET 0x20  // IRQ[0..7] -> INT[0x20..0x27]
+#define PIC_SLAVE_OFFSET 0x28   // IRQ[8..15] -> INT[0x28..0x2F]
+
+#define PIC_EOI 0x20
+
+#define PIC_IRQ_LINES 16
+// Handlers registered with pic_irq_register, over all lines.
+#define PIC_IRQ_MAX_HANDLERS 16
+
+// Interrupt vector an IRQ line is delivered on.
+#define PIC_IRQ_VECTOR(irq) (PIC_MASTER_OFFSET + (irq))
+
+// Device interrupt handler, called with interrupts disabled.
+typedef void (*pic_irq_fn)(void *ctx);
+
+typedef struct pic_irq_handler {
+    pic_irq_fn fn;
+    void *ctx;
+    struct pic_irq_handler *next;
+} pic_irq_handler;
+
 void pic_init();
 
+// Signal end of interrupt for `irq`, IRQs routed through the slave PIC need
+// an EOI on both controllers.
+void pic_eoi(uint8_t irq);
+
+// Add `fn` to the handlers of IRQ line `irq`, installing the line's
+// dispatcher on its vector with the first one.
+//
+// PCI INTx lines are routinely shared, so every handler of the line runs on
+// each interrupt and must cope with its device not being the one which
+// raised it. The line gets a single EOI once all of them ran. Returns 0 if
+// the line is invalid or the handler table is full.
+int pic_irq_register(uint8_t irq, pic_irq_fn fn, void *ctx);
+
 #endif // PIC_H
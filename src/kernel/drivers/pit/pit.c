@@ -0,0 +1,62 @@
+#include "pit.h"
+
+#include <stdint.h>
+
+#include "../../cpu/cpu.h"
+#include "../../idt.h"
+#include "../../io/io.h"
+#include "../pic/pic.h"
+
+volatile uint64_t pit_ticks;
+pit_callback pit_tick_callback;
+
+void pit_irq(uint32_t *stack) {
+    pit_ticks++;
+    if (pit_tick_callback) {
+        pit_tick_callback(stack);
+    }
+    pic_eoi(PIT_IRQ);
+}
+idt_handler(pit_handler_irq, pit_irq);
+
+void pit_init() {
+    pit_ticks = 0;
+    pit_tick_callback = 0;
+    idt_set(PIC_IRQ_VECTOR(PIT_IRQ), pit_handler_irq);
+}
+
+void pit_set_frequency(uint32_t hz) {
+    // the 16 bit reload value wraps 65536, the slowest rate, to 0.
+    uint32_t divisor = hz ? PIT_FREQUENCY / hz : 0;
+    if (!hz || divisor > 0xFFFF) {
+        divisor = 0;
+    } else if (divisor < 1) {
+        divisor = 1;
+    }
+    io_out8(PIT_PORT_COMMAND, PIT_COMMAND_CHANNEL0 | PIT_MODE_RATE_GENERATOR);
+    io_out8(PIT_PORT_CHANNEL0, divisor & 0xFF);
+    io_out8(PIT_PORT_CHANNEL0, (divisor >> 8) & 0xFF);
+}
+
+void pit_set_oneshot(uint16_t count) {
+    io_out8(PIT_PORT_COMMAND,
+            PIT_COMMAND_CHANNEL0 | PIT_MODE_INTERRUPT_ON_TERMINAL_COUNT);
+    io_out8(PIT_PORT_CHANNEL0, count & 0xFF);
+    io_out8(PIT_PORT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+void pit_stop() {
+    // the counter waits for a new count after a mode change.
+    io_out8(PIT_PORT_COMMAND,
+            PIT_COMMAND_CHANNEL0 | PIT_MODE_INTERRUPT_ON_TERMINAL_COUNT);
+}
+
+void pit_set_callback(pit_callback callback) { pit_tick_callback = callback; }
+
+uint64_t pit_get_ticks() {
+    // a 64 bit load is two instructions, keep the IRQ out of the middle.
+    uint32_t flags = cpu_irq_save();
+    uint64_t ticks = pit_ticks;
+    cpu_irq_restore(flags);
+    return ticks;
+}
@@ -0,0 +1,41 @@
+#ifndef PIT_H
+#define PIT_H
+
+#include <stdint.h>
+
+#define PIT_PORT_CHANNEL0 0x40
+#define PIT_PORT_COMMAND 0x43
+
+// channel 0, lobyte/hibyte access.
+#define PIT_COMMAND_CHANNEL0 0x30
+#define PIT_MODE_INTERRUPT_ON_TERMINAL_COUNT 0x00
+#define PIT_MODE_RATE_GENERATOR 0x04
+
+#define PIT_FREQUENCY 1193182
+#define PIT_IRQ 0
+
+// Called from the timer interrupt with the interrupted register frame, see
+// idt_handler.
+typedef void (*pit_callback)(uint32_t *stack);
+
+// Install the IRQ0 handler, the timer keeps its current (BIOS) rate until
+// pit_set_frequency is called.
+void pit_init();
+
+// Program channel 0 to interrupt `hz` times per second.
+void pit_set_frequency(uint32_t hz);
+
+// Start a one-shot countdown of `count` input clocks, IRQ0 fires once when it
+// reaches zero. A count of 0 counts 65536 clocks.
+void pit_set_oneshot(uint16_t count);
+
+// Stop channel 0, it raises no interrupt until it is programmed again.
+void pit_stop();
+
+// Set the function called on every timer interrupt, 0 to clear it.
+void pit_set_callback(pit_callback callback);
+
+// Number of timer interrupts since pit_init.
+uint64_t pit_get_ticks();
+
+#endif  // PIT_H
@@ -0,0 +1,64 @@
+#include "serial.h"
+
+#include <stdint.h>
+
+#include "../../io/io.h"
+
+void serial_init() {
+    uint16_t port = SERIAL_COM1;
+    uint16_t divisor = SERIAL_BAUD_BASE / 115200;
+
+    io_out8(SERIAL_PORT_INT_ENABLE(port), 0x00);
+    io_out8(SERIAL_PORT_LINE_CTRL(port), SERIAL_LINE_DLAB);
+    io_out8(SERIAL_PORT_DATA(port), divisor & 0xFF);
+    io_out8(SERIAL_PORT_INT_ENABLE(port), divisor >> 8);
+    io_out8(SERIAL_PORT_LINE_CTRL(port), SERIAL_LINE_8N1);
+    // enable and clear the FIFOs, 14 byte threshold.
+    io_out8(SERIAL_PORT_FIFO_CTRL(port), 0xC7);
+    // DTR, RTS and OUT2.
+    io_out8(SERIAL_PORT_MODEM_CTRL(port), 0x0B);
+}
+
+void serial_write_char(char c) {
+    while (!(io_ins8(SERIAL_PORT_LINE_STATUS(SERIAL_COM1)) &
+             SERIAL_LINE_STATUS_THRE)) {
+    }
+    io_out8(SERIAL_PORT_DATA(SERIAL_COM1), c);
+}
+
+void serial_write_str(const char *str) {
+    while (*str) {
+        serial_write_char(*str++);
+    }
+}
+
+void serial_write_hex(uint32_t value) {
+    const char *digits = "0123456789abcdef";
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        serial_write_char(digits[(value >> shift) & 0xF]);
+    }
+}
+
+void serial_write_dec(uint64_t value) {
+    // subtract powers of ten, a 64 bit division would need libgcc.
+    uint64_t power = 1;
+    int digits = 1;
+    while (digits < 20 && value >= power * 10) {
+        power *= 10;
+        digits++;
+    }
+    while (digits--) {
+        char digit = '0';
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        serial_write_char(digit);
+        // step down to the next power of ten by rebuilding it.
+        uint64_t next = 1;
+        for (int i = 1; i < digits; i++) {
+            next *= 10;
+        }
+        power = next;
+    }
+}
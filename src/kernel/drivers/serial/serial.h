@@ -0,0 +1,38 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+#define SERIAL_COM1 0x3F8
+
+#define SERIAL_PORT_DATA(port) (port)
+#define SERIAL_PORT_INT_ENABLE(port) (port + 1)
+#define SERIAL_PORT_FIFO_CTRL(port) (port + 2)
+#define SERIAL_PORT_LINE_CTRL(port) (port + 3)
+#define SERIAL_PORT_MODEM_CTRL(port) (port + 4)
+#define SERIAL_PORT_LINE_STATUS(port) (port + 5)
+
+// with the divisor latch bit set, the data and interrupt enable registers
+// hold the baud rate divisor.
+#define SERIAL_LINE_DLAB 0x80
+#define SERIAL_LINE_8N1 0x03
+#define SERIAL_LINE_STATUS_THRE 0x20
+
+#define SERIAL_BAUD_BASE 115200
+
+// Initialize COM1 for 115200 baud 8N1, polled output.
+void serial_init();
+
+// Write a byte, waiting for room in the transmit holding register.
+void serial_write_char(char c);
+
+// Writes a null terminated string.
+void serial_write_str(const char *str);
+
+// Writes `value` as 8 lower case hex digits, without a prefix.
+void serial_write_hex(uint32_t value);
+
+// Writes `value` in decimal.
+void serial_write_dec(uint64_t value);
+
+#endif  // SERIAL_H
@@ -2,7 +2,9 @@
 
 #include <stdint.h>
 
-#define VGA_MEMORY_COLOR 0xB8000
+#include "../../memory/memory.h"
+
+#define VGA_MEMORY_COLOR MEMORY_VIRT(0xB8000)
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 
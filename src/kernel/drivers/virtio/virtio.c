@@ -0,0 +1,137 @@
+#include "virtio.h"
+
+#include <stdint.h>
+
+#include "../../io/io.h"
+#include "../../memory/heap.h"
+#include "../../memory/memory.h"
+
+// compiler barrier, enough to order stores against stores and loads against
+// loads on x86.
+#define virtio_barrier() asm volatile("" : : : "memory")
+// full barrier, a store followed by a load of another location may otherwise
+// be reordered.
+#define virtio_mb() asm volatile("lock; addl $0, (%%esp)" : : : "memory")
+
+#define VIRTIO_ALIGN(x) \
+    (((x) + VIRTIO_PCI_QUEUE_ALIGN - 1) & ~(VIRTIO_PCI_QUEUE_ALIGN - 1))
+
+int virtio_init(virtio_device *dev, const pci_device *pci, uint32_t wanted) {
+    if (!(pci->bar[0] & PCI_BAR_IO_F)) {
+        return 0;
+    }
+    dev->pci = *pci;
+    dev->io = pci->bar[0] & PCI_BAR_IO_MASK;
+    pci_enable(pci);
+
+    io_out8(dev->io + VIRTIO_PCI_STATUS, 0);
+    io_out8(dev->io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    io_out8(dev->io + VIRTIO_PCI_STATUS,
+            VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    dev->features = io_ins32(dev->io + VIRTIO_PCI_DEVICE_FEATURES) & wanted;
+    io_out32(dev->io + VIRTIO_PCI_GUEST_FEATURES, dev->features);
+    return 1;
+}
+
+int virtio_queue_init(virtio_device *dev, uint16_t index, virtq *vq) {
+    io_out16(dev->io + VIRTIO_PCI_QUEUE_SELECT, index);
+    uint16_t size = io_ins16(dev->io + VIRTIO_PCI_QUEUE_SIZE);
+    if (!size) {
+        return 0;
+    }
+
+    // descriptors and the avail ring (plus used_event), then the used ring
+    // (plus avail_event) on the next aligned boundary.
+    uint32_t avail_end = sizeof(virtq_desc) * size + 6 + 2 * size;
+    uint32_t used_start = VIRTIO_ALIGN(avail_end);
+    uint32_t total =
+        used_start + VIRTIO_ALIGN(6 + sizeof(virtq_used_elem) * size);
+
+    uint8_t *mem = heap_zalloc(total);
+    if (!mem) {
+        return 0;
+    }
+
+    vq->size = size;
+    vq->desc = (virtq_desc *)mem;
+    vq->avail = (virtq_avail *)(mem + sizeof(virtq_desc) * size);
+    vq->used = (virtq_used *)(mem + used_start);
+    vq->used_event = &vq->avail->ring[size];
+    vq->avail_event = (uint16_t *)&vq->used->ring[size];
+    vq->last_used = 0;
+    vq->notified = 0;
+    vq->event_idx = (dev->features & VIRTIO_RING_F_EVENT_IDX) != 0;
+
+    io_out32(dev->io + VIRTIO_PCI_QUEUE_PFN,
+             MEMORY_PHYS(mem) >> VIRTIO_PCI_QUEUE_PFN_SHIFT);
+    return 1;
+}
+
+void virtio_queue_free(virtio_device *dev, uint16_t index, virtq *vq) {
+    io_out16(dev->io + VIRTIO_PCI_QUEUE_SELECT, index);
+    io_out32(dev->io + VIRTIO_PCI_QUEUE_PFN, 0);
+    heap_free((void *)vq->desc);
+    memset(vq, 0, sizeof(virtq));
+}
+
+void virtio_driver_ok(virtio_device *dev) {
+    io_out8(dev->io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACKNOWLEDGE |
+                                             VIRTIO_STATUS_DRIVER |
+                                             VIRTIO_STATUS_DRIVER_OK);
+}
+
+void virtq_push(virtq *vq, uint16_t head) {
+    vq->avail->ring[vq->avail->idx % vq->size] = head;
+    // the entry must be visible before the index which publishes it.
+    virtio_barrier();
+    vq->avail->idx++;
+}
+
+// True if `event` lies in the window of entries published since the last
+// notification, (old, new].
+int virtq_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+void virtq_kick(virtio_device *dev, uint16_t index, virtq *vq) {
+    virtio_mb();
+    uint16_t new_idx = vq->avail->idx;
+    uint16_t old_idx = vq->notified;
+    if (new_idx == old_idx) {
+        return;
+    }
+    vq->notified = new_idx;
+
+    int notify = vq->event_idx
+                     ? virtq_need_event(*vq->avail_event, new_idx, old_idx)
+                     : !(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    if (notify) {
+        io_out16(dev->io + VIRTIO_PCI_QUEUE_NOTIFY, index);
+    }
+}
+
+int virtq_pop(virtq *vq, virtq_used_elem *elem) {
+    if (vq->last_used == vq->used->idx) {
+        return 0;
+    }
+    // read the entry only after observing the index which published it.
+    virtio_barrier();
+    *elem = vq->used->ring[vq->last_used % vq->size];
+    vq->last_used++;
+    return 1;
+}
+
+int virtq_enable_interrupt(virtq *vq) {
+    if (vq->event_idx) {
+        *vq->used_event = vq->last_used;
+    } else {
+        vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+    virtio_mb();
+    return vq->last_used != vq->used->idx;
+}
+
+uint8_t virtio_isr(virtio_device *dev) {
+    return io_ins8(dev->io + VIRTIO_PCI_ISR);
+}
@@ -0,0 +1,120 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+
+#include "../pci/pci.h"
+
+#define VIRTIO_PCI_VENDOR 0x1AF4
+
+// Legacy PCI transport registers, relative to the I/O space in BAR0.
+#define VIRTIO_PCI_DEVICE_FEATURES 0x00
+#define VIRTIO_PCI_GUEST_FEATURES 0x04
+#define VIRTIO_PCI_QUEUE_PFN 0x08
+#define VIRTIO_PCI_QUEUE_SIZE 0x0C
+#define VIRTIO_PCI_QUEUE_SELECT 0x0E
+#define VIRTIO_PCI_QUEUE_NOTIFY 0x10
+#define VIRTIO_PCI_STATUS 0x12
+#define VIRTIO_PCI_ISR 0x13
+// device specific configuration, without MSI-X.
+#define VIRTIO_PCI_CONFIG 0x14
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER 0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FAILED 0x80
+
+#define VIRTIO_RING_F_INDIRECT_DESC (1 << 28)
+#define VIRTIO_RING_F_EVENT_IDX (1 << 29)
+
+// the legacy transport takes the queue address as a 4KiB page number.
+#define VIRTIO_PCI_QUEUE_ALIGN 4096
+#define VIRTIO_PCI_QUEUE_PFN_SHIFT 12
+
+#define VIRTQ_DESC_F_NEXT 1
+#define VIRTQ_DESC_F_WRITE 2
+#define VIRTQ_DESC_F_INDIRECT 4
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+#define VIRTQ_USED_F_NO_NOTIFY 1
+
+typedef struct virtq_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc;
+
+// `ring` is followed by `used_event` when VIRTIO_RING_F_EVENT_IDX is used.
+typedef struct virtq_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} virtq_avail;
+
+typedef struct virtq_used_elem {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem;
+
+// `ring` is followed by `avail_event` when VIRTIO_RING_F_EVENT_IDX is used.
+typedef struct virtq_used {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem ring[];
+} virtq_used;
+
+// A split virtqueue, laid out in one physically contiguous allocation as the
+// legacy transport requires.
+typedef struct virtq {
+    uint16_t size;
+    volatile virtq_desc *desc;
+    volatile virtq_avail *avail;
+    volatile virtq_used *used;
+    volatile uint16_t *used_event;
+    volatile uint16_t *avail_event;
+    // next used ring entry the driver has not consumed.
+    uint16_t last_used;
+    // avail->idx at the last notification.
+    uint16_t notified;
+    uint8_t event_idx;
+} virtq;
+
+typedef struct virtio_device {
+    pci_device pci;
+    uint16_t io;
+    uint32_t features;
+} virtio_device;
+
+// Reset the device, acknowledge it and negotiate the features in `wanted`
+// which the device offers. Returns 0 if the device has no legacy I/O BAR.
+int virtio_init(virtio_device *dev, const pci_device *pci, uint32_t wanted);
+
+// Allocate and register virtqueue `index`, sized as the device requests.
+int virtio_queue_init(virtio_device *dev, uint16_t index, virtq *vq);
+
+// Unregister virtqueue `index` and free its memory, for a device which never
+// got driver OK or was marked failed.
+void virtio_queue_free(virtio_device *dev, uint16_t index, virtq *vq);
+
+// Mark driver setup as complete, the device may now use its queues.
+void virtio_driver_ok(virtio_device *dev);
+
+// Publish descriptor chain `head` in the avail ring, without notifying.
+void virtq_push(virtq *vq, uint16_t head);
+
+// Notify the device of newly published buffers if it asked to be, with
+// event index suppression only once per crossed `avail_event`.
+void virtq_kick(virtio_device *dev, uint16_t index, virtq *vq);
+
+// Return 1 and the next used element if the device has consumed one.
+int virtq_pop(virtq *vq, virtq_used_elem *elem);
+
+// Ask for an interrupt at the next completion, returns 1 if more used
+// entries arrived meanwhile and must be popped first.
+int virtq_enable_interrupt(virtq *vq);
+
+// Read and acknowledge the ISR status register.
+uint8_t virtio_isr(virtio_device *dev);
+
+#endif  // VIRTIO_H
@@ -0,0 +1,242 @@
+#include "virtio_blk.h"
+
+#include <stdint.h>
+
+#include "../../io/io.h"
+#include "../../memory/heap.h"
+#include "../../memory/memory.h"
+#include "../../memory/paging.h"
+#include "../pic/pic.h"
+
+#define VIRTIO_BLK_HEADER_OFFSET 0
+#define VIRTIO_BLK_STATUS_OFFSET 16
+#define VIRTIO_BLK_TABLE_OFFSET 32
+
+#if VIRTIO_BLK_TABLE_OFFSET + \
+        (BLK_REQUEST_MAX_SEGMENTS + 2) * 16 > PAGE_SIZE
+#error "virtio-blk request slot does not fit a page"
+#endif
+
+virtio_blk virtio_blk_devices[VIRTIO_BLK_MAX_DEVICES];
+uint32_t virtio_blk_count;
+
+const char *virtio_blk_names[VIRTIO_BLK_MAX_DEVICES] = {"vda", "vdb"};
+
+// blk_queue start routine, describes the request in its slot's indirect
+// table and publishes it. The device is notified once per dispatch round by
+// virtio_blk_commit.
+int virtio_blk_start(blk_queue *q, blk_request *req) {
+    virtio_blk *vb = q->priv;
+    if (!vb->free_slots) {
+        return 0;
+    }
+    uint16_t id = __builtin_ctz(vb->free_slots);
+    vb->free_slots &= ~(1u << id);
+
+    virtio_blk_slot *slot = &vb->slots[id];
+    slot->req = req;
+    slot->header->type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    slot->header->reserved = 0;
+    slot->header->sector = req->lba;
+    *slot->status = 0xFF;
+
+    virtq_desc *t = slot->table;
+    t[0].addr = MEMORY_PHYS(slot->header);
+    t[0].len = sizeof(virtio_blk_header);
+    t[0].flags = VIRTQ_DESC_F_NEXT;
+    t[0].next = 1;
+
+    uint16_t n = 1;
+    for (uint32_t i = 0; i < req->seg_count; i++, n++) {
+        t[n].addr = req->segs[i].page + req->segs[i].offset;
+        t[n].len = req->segs[i].length;
+        t[n].flags = VIRTQ_DESC_F_NEXT | (req->write ? 0 : VIRTQ_DESC_F_WRITE);
+        t[n].next = n + 1;
+    }
+
+    t[n].addr = MEMORY_PHYS(slot->status);
+    t[n].len = 1;
+    t[n].flags = VIRTQ_DESC_F_WRITE;
+    t[n].next = 0;
+    n++;
+
+    // ring descriptor `id` is owned by slot `id`, so the used element's id
+    // names the slot directly.
+    vb->vq.desc[id].addr = MEMORY_PHYS(t);
+    vb->vq.desc[id].len = n * sizeof(virtq_desc);
+    vb->vq.desc[id].flags = VIRTQ_DESC_F_INDIRECT;
+    vb->vq.desc[id].next = 0;
+
+    virtq_push(&vb->vq, id);
+    return 1;
+}
+
+void virtio_blk_commit(blk_queue *q) {
+    virtio_blk *vb = q->priv;
+    virtq_kick(&vb->vdev, 0, &vb->vq);
+}
+
+// Complete every request the device has returned, then re-arm the interrupt
+// for the next completion.
+void virtio_blk_service(virtio_blk *vb) {
+    virtio_isr(&vb->vdev);
+
+    do {
+        virtq_used_elem elem;
+        while (virtq_pop(&vb->vq, &elem)) {
+            if (elem.id >= vb->depth) {
+                continue;
+            }
+            virtio_blk_slot *slot = &vb->slots[elem.id];
+            blk_request *req = slot->req;
+            int ok = *slot->status == VIRTIO_BLK_S_OK;
+            slot->req = 0;
+            vb->free_slots |= 1u << elem.id;
+            blk_queue_complete(&vb->queue, req, ok);
+        }
+    } while (virtq_enable_interrupt(&vb->vq));
+}
+
+void virtio_blk_poll(blk_queue *q) { virtio_blk_service(q->priv); }
+
+// Shared line handler, reading the ISR in virtio_blk_service makes servicing
+// a device which did not interrupt harmless.
+void virtio_blk_irq(void *ctx) { virtio_blk_service(ctx); }
+
+// Mark the device failed and free the slot pages and virtqueue a probe
+// allocated for it.
+void virtio_blk_fail(virtio_blk *vb) {
+    io_out8(vb->vdev.io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+    for (uint32_t i = 0; i < vb->depth; i++) {
+        if (vb->slots[i].header) {
+            heap_free((uint8_t *)vb->slots[i].header -
+                      VIRTIO_BLK_HEADER_OFFSET);
+        }
+        memset(&vb->slots[i], 0, sizeof(virtio_blk_slot));
+    }
+    vb->free_slots = 0;
+    virtio_queue_free(&vb->vdev, 0, &vb->vq);
+}
+
+int virtio_blk_probe(virtio_blk *vb, const pci_device *pci) {
+    if (!virtio_init(&vb->vdev, pci,
+                     VIRTIO_RING_F_INDIRECT_DESC | VIRTIO_RING_F_EVENT_IDX |
+                         VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX)) {
+        return 0;
+    }
+    // every request is one indirect chain, devices without indirect
+    // descriptors are not supported.
+    if (!(vb->vdev.features & VIRTIO_RING_F_INDIRECT_DESC) ||
+        !virtio_queue_init(&vb->vdev, 0, &vb->vq)) {
+        io_out8(vb->vdev.io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+        return 0;
+    }
+
+    vb->depth = vb->vq.size < VIRTIO_BLK_DEPTH ? vb->vq.size : VIRTIO_BLK_DEPTH;
+    for (uint32_t i = 0; i < vb->depth; i++) {
+        uint8_t *page = heap_zalloc(PAGE_SIZE);
+        if (!page) {
+            virtio_blk_fail(vb);
+            return 0;
+        }
+        vb->slots[i].header = (virtio_blk_header *)(page + VIRTIO_BLK_HEADER_OFFSET);
+        vb->slots[i].status = page + VIRTIO_BLK_STATUS_OFFSET;
+        vb->slots[i].table = (virtq_desc *)(page + VIRTIO_BLK_TABLE_OFFSET);
+        vb->free_slots |= 1u << i;
+    }
+
+    uint16_t config = vb->vdev.io + VIRTIO_PCI_CONFIG;
+    uint64_t capacity =
+        io_ins32(config + VIRTIO_BLK_CONFIG_CAPACITY) |
+        (uint64_t)io_ins32(config + VIRTIO_BLK_CONFIG_CAPACITY + 4) << 32;
+
+    uint32_t max_segments = BLK_REQUEST_MAX_SEGMENTS;
+    if (vb->vdev.features & VIRTIO_BLK_F_SEG_MAX) {
+        uint32_t seg_max = io_ins32(config + VIRTIO_BLK_CONFIG_SEG_MAX);
+        if (seg_max && seg_max < max_segments) {
+            max_segments = seg_max;
+        }
+    }
+    uint32_t max_segment_bytes = 0x10000;
+    if (vb->vdev.features & VIRTIO_BLK_F_SIZE_MAX) {
+        uint32_t size_max = io_ins32(config + VIRTIO_BLK_CONFIG_SIZE_MAX);
+        size_max &= ~(BLK_SECTOR_SIZE - 1);
+        if (size_max && size_max < max_segment_bytes) {
+            max_segment_bytes = size_max;
+        }
+    }
+
+    blk_queue_init(&vb->queue, vb->depth, 0x10000, max_segments,
+                   max_segment_bytes, virtio_blk_start, virtio_blk_poll, vb);
+    vb->queue.commit = virtio_blk_commit;
+
+    vb->blk.name = virtio_blk_names[virtio_blk_count];
+    vb->blk.sectors = capacity;
+    vb->blk.queue = &vb->queue;
+    vb->blk.priv = vb;
+
+    if (!pic_irq_register(pci->irq_line, virtio_blk_irq, vb)) {
+        virtio_blk_fail(vb);
+        return 0;
+    }
+    virtq_enable_interrupt(&vb->vq);
+    virtio_driver_ok(&vb->vdev);
+    return 1;
+}
+
+int virtio_blk_init() {
+    pci_device pci;
+    for (uint32_t n = 0; virtio_blk_count < VIRTIO_BLK_MAX_DEVICES &&
+                         pci_find_device(VIRTIO_PCI_VENDOR,
+                                         VIRTIO_BLK_DEVICE_ID, n, &pci);
+         n++) {
+        virtio_blk *vb = &virtio_blk_devices[virtio_blk_count];
+        memset(vb, 0, sizeof(virtio_blk));
+        if (!virtio_blk_probe(vb, &pci)) {
+            continue;
+        }
+        blk_register(&vb->blk);
+        virtio_blk_count++;
+    }
+    return virtio_blk_count != 0;
+}
+
+// Validate a single buffer request against the device, like
+// ata_buffer_segment.
+virtio_blk *virtio_blk_buffer_segment(uint8_t dev, uint64_t start_lba,
+                                      uint64_t count, const void *buffer,
+                                      blk_segment *seg) {
+    if (dev >= virtio_blk_count || !count) {
+        return 0;
+    }
+    virtio_blk *vb = &virtio_blk_devices[dev];
+    if (start_lba >= vb->blk.sectors || count > vb->blk.sectors - start_lba) {
+        return 0;
+    }
+    seg->page = MEMORY_PHYS(buffer);
+    seg->offset = 0;
+    seg->length = count * BLK_SECTOR_SIZE;
+    return vb;
+}
+
+int virtio_blk_read_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                            uint16_t buffer[]) {
+    blk_segment seg;
+    virtio_blk *vb =
+        virtio_blk_buffer_segment(dev, start_lba, count, buffer, &seg);
+    if (!vb) {
+        return 0;
+    }
+    return blk_readv(&vb->blk, start_lba, &seg, 1);
+}
+
+int virtio_blk_write_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                             const uint16_t buffer[]) {
+    blk_segment seg;
+    virtio_blk *vb =
+        virtio_blk_buffer_segment(dev, start_lba, count, buffer, &seg);
+    if (!vb) {
+        return 0;
+    }
+    return blk_writev(&vb->blk, start_lba, &seg, 1);
+}
@@ -0,0 +1,70 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+
+#include "../blk/blk.h"
+#include "virtio.h"
+
+// transitional (legacy capable) virtio-blk PCI device id.
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+#define VIRTIO_BLK_MAX_DEVICES 2
+// Requests in flight per device, each owns one ring descriptor pointing at
+// its own indirect descriptor table.
+#define VIRTIO_BLK_DEPTH 32
+
+#define VIRTIO_BLK_F_SIZE_MAX (1 << 1)
+#define VIRTIO_BLK_F_SEG_MAX (1 << 2)
+
+// device configuration offsets, relative to VIRTIO_PCI_CONFIG.
+#define VIRTIO_BLK_CONFIG_CAPACITY 0x00
+#define VIRTIO_BLK_CONFIG_SIZE_MAX 0x08
+#define VIRTIO_BLK_CONFIG_SEG_MAX 0x0C
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_S_OK 0
+
+typedef struct virtio_blk_header {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_header;
+
+// Per request memory, one page holding the request header, the status byte
+// written by the device and the indirect descriptor table.
+typedef struct virtio_blk_slot {
+    blk_request *req;
+    virtio_blk_header *header;
+    volatile uint8_t *status;
+    virtq_desc *table;
+} virtio_blk_slot;
+
+typedef struct virtio_blk {
+    virtio_device vdev;
+    virtq vq;
+    blk_device blk;
+    blk_queue queue;
+    uint32_t depth;
+    virtio_blk_slot slots[VIRTIO_BLK_DEPTH];
+    // bit n set when slots[n] is free.
+    uint32_t free_slots;
+} virtio_blk;
+
+// Probe PCI for virtio-blk devices and register them as block devices named
+// "vda", "vdb".
+//
+// Requests go through the blk queue with up to VIRTIO_BLK_DEPTH in flight,
+// completions are interrupt driven and event index suppression, when the
+// device offers it, limits both notifications and interrupts.
+int virtio_blk_init();
+
+// Same semantics as ata_read_sectors, for virtio-blk device `dev`.
+int virtio_blk_read_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                            uint16_t buffer[]);
+
+// Same semantics as ata_write_sectors, for virtio-blk device `dev`.
+int virtio_blk_write_sectors(uint8_t dev, uint64_t start_lba, uint64_t count,
+                             const uint16_t buffer[]);
+
+#endif  // VIRTIO_BLK_H
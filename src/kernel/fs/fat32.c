@@ -0,0 +1,476 @@
+#include "fat32.h"
+
+#include <stdint.h>
+
+#include "../drivers/blk/blk.h"
+#include "../memory/heap.h"
+#include "../memory/memory.h"
+#include "../memory/paging.h"
+#include "page_cache.h"
+
+#define FAT32_SECTORS_PER_PAGE (PAGE_SIZE / BLK_SECTOR_SIZE)
+#define FAT32_ENTRIES_PER_SECTOR (BLK_SECTOR_SIZE / sizeof(uint32_t))
+
+// Mounted volume, all sector numbers are absolute device LBAs.
+struct {
+    uint8_t mounted;
+    blk_device *blk;
+    uint32_t part_lba;
+    uint32_t fat_lba;
+    uint32_t data_lba;
+    uint32_t sectors_per_cluster;
+    uint32_t clusters;
+    uint32_t root_cluster;
+} volume;
+
+fat32_inode inodes[FAT32_MAX_INODES];
+
+// Read the FAT entry for `cluster`, returns 0 on error.
+uint32_t fat32_next_cluster(uint32_t cluster) {
+    uint32_t sector = volume.fat_lba + cluster / FAT32_ENTRIES_PER_SECTOR;
+    page_cache_page *page = page_cache_device_page(
+        volume.blk, sector / FAT32_SECTORS_PER_PAGE);
+    if (!page) {
+        return 0;
+    }
+    uint32_t *entries =
+        (uint32_t *)((uint8_t *)page->data +
+                     (sector % FAT32_SECTORS_PER_PAGE) * BLK_SECTOR_SIZE);
+    return entries[cluster % FAT32_ENTRIES_PER_SECTOR] & FAT32_CLUSTER_MASK;
+}
+
+int fat32_extent_append(fat32_inode *inode, uint32_t file_sector,
+                        uint32_t lba, uint32_t sectors) {
+    if (inode->extent_count) {
+        fat32_extent *last = &inode->extents[inode->extent_count - 1];
+        if (last->lba + last->sectors == lba) {
+            last->sectors += sectors;
+            return 1;
+        }
+    }
+
+    if (inode->extent_count == inode->extent_capacity) {
+        uint32_t capacity = inode->extent_capacity
+                                ? inode->extent_capacity * 2
+                                : PAGE_SIZE / sizeof(fat32_extent);
+        fat32_extent *extents = heap_malloc(capacity * sizeof(fat32_extent));
+        if (!extents) {
+            return 0;
+        }
+        if (inode->extents) {
+            memcpy(extents, inode->extents,
+                   inode->extent_count * sizeof(fat32_extent));
+            heap_free(inode->extents);
+        }
+        inode->extents = extents;
+        inode->extent_capacity = capacity;
+    }
+
+    fat32_extent *e = &inode->extents[inode->extent_count++];
+    e->file_sector = file_sector;
+    e->lba = lba;
+    e->sectors = sectors;
+    return 1;
+}
+
+// Walk the cluster chain starting at `cluster` and coalesce it into extents.
+int fat32_build_extents(fat32_inode *inode, uint32_t cluster) {
+    uint32_t file_sector = 0;
+    uint32_t walked = 0;
+
+    while (cluster >= 2 && cluster < FAT32_CLUSTER_BAD) {
+        // a chain longer than the volume means a corrupt (looping) FAT.
+        if (cluster >= volume.clusters + 2 || walked++ > volume.clusters) {
+            return 0;
+        }
+        uint32_t lba =
+            volume.data_lba + (cluster - 2) * volume.sectors_per_cluster;
+        if (!fat32_extent_append(inode, file_sector, lba,
+                                 volume.sectors_per_cluster)) {
+            return 0;
+        }
+        file_sector += volume.sectors_per_cluster;
+
+        cluster = fat32_next_cluster(cluster);
+    }
+
+    // an empty file has no clusters, its directory entry holds cluster 0.
+    return cluster >= FAT32_CLUSTER_EOC || (cluster == 0 && walked == 0);
+}
+
+// Map a file relative sector to its device LBA, `run` is set to the number
+// of contiguous sectors starting at the returned LBA.
+int fat32_bmap(fat32_inode *inode, uint32_t file_sector, uint32_t *lba,
+               uint32_t *run) {
+    uint32_t lo = 0;
+    uint32_t hi = inode->extent_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        fat32_extent *e = &inode->extents[mid];
+        if (file_sector < e->file_sector) {
+            hi = mid;
+        } else if (file_sector >= e->file_sector + e->sectors) {
+            lo = mid + 1;
+        } else {
+            *lba = e->lba + (file_sector - e->file_sector);
+            *run = e->sectors - (file_sector - e->file_sector);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void fat32_inode_release_extents(fat32_inode *inode) {
+    if (inode->extents) {
+        heap_free(inode->extents);
+    }
+    memset(inode, 0, sizeof(fat32_inode));
+}
+
+fat32_inode *fat32_iget(uint32_t cluster, uint32_t size, uint8_t attr) {
+    fat32_inode *slot = 0;
+    for (uint32_t i = 0; i < FAT32_MAX_INODES; i++) {
+        fat32_inode *inode = &inodes[i];
+        if (inode->extents && inode->inode == cluster) {
+            inode->refs++;
+            return inode;
+        }
+        // prefer never used slots over evicting a cached inode.
+        if (!inode->refs && (!slot || (slot->extents && !inode->extents))) {
+            slot = inode;
+        }
+    }
+    if (!slot) {
+        return 0;
+    }
+
+    fat32_inode_release_extents(slot);
+    slot->inode = cluster;
+    slot->attr = attr;
+    slot->size = size;
+
+    if (!fat32_build_extents(slot, cluster)) {
+        fat32_inode_release_extents(slot);
+        return 0;
+    }
+
+    // directory entries do not record a size, use the allocated size.
+    if (attr & FAT32_ATTR_DIRECTORY) {
+        slot->size = 0;
+        if (slot->extent_count) {
+            fat32_extent *last = &slot->extents[slot->extent_count - 1];
+            slot->size = (last->file_sector + last->sectors) * BLK_SECTOR_SIZE;
+        }
+    }
+
+    slot->refs = 1;
+    return slot;
+}
+
+fat32_inode *fat32_get(fat32_inode *inode) {
+    inode->refs++;
+    return inode;
+}
+
+void fat32_put(fat32_inode *inode) {
+    if (inode && inode->refs) {
+        inode->refs--;
+    }
+}
+
+// Fill the page cache for `index` and read ahead the following pages which
+// are not cached yet.
+//
+// Each contiguous extent run is read with one vectored request whose
+// segments point straight at the cache pages, so data lands in place.
+page_cache_page *fat32_fill(fat32_inode *inode, uint32_t index) {
+    uint32_t file_pages = (inode->size + PAGE_SIZE - 1) / PAGE_SIZE;
+    page_cache_page *batch[FAT32_READAHEAD_PAGES];
+    blk_segment segs[FAT32_READAHEAD_PAGES];
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < FAT32_READAHEAD_PAGES; i++) {
+        if (index + i >= file_pages) {
+            break;
+        }
+        if (i && page_cache_lookup(inode->inode, index + i)) {
+            break;
+        }
+        batch[i] = page_cache_alloc(inode->inode, index + i);
+        if (!batch[i]) {
+            break;
+        }
+        count++;
+    }
+    if (!count) {
+        return 0;
+    }
+
+    uint32_t first = index * FAT32_SECTORS_PER_PAGE;
+    uint32_t sector = first;
+    uint32_t end = sector + count * FAT32_SECTORS_PER_PAGE;
+    uint32_t file_sectors = (inode->size + BLK_SECTOR_SIZE - 1) / BLK_SECTOR_SIZE;
+    if (end > file_sectors) {
+        end = file_sectors;
+    }
+
+    int ok = 1;
+    while (ok && sector < end) {
+        uint32_t lba, run;
+        if (!fat32_bmap(inode, sector, &lba, &run)) {
+            ok = 0;
+            break;
+        }
+        if (run > end - sector) {
+            run = end - sector;
+        }
+
+        // split the run at page boundaries, one segment per cache page.
+        uint32_t nsegs = 0;
+        for (uint32_t s = sector; s < sector + run;) {
+            uint32_t page = (s - first) / FAT32_SECTORS_PER_PAGE;
+            uint32_t in_page = (s - first) % FAT32_SECTORS_PER_PAGE;
+            uint32_t n = FAT32_SECTORS_PER_PAGE - in_page;
+            if (n > sector + run - s) {
+                n = sector + run - s;
+            }
+            segs[nsegs].page = MEMORY_PHYS(batch[page]->data);
+            segs[nsegs].offset = in_page * BLK_SECTOR_SIZE;
+            segs[nsegs].length = n * BLK_SECTOR_SIZE;
+            nsegs++;
+            s += n;
+        }
+
+        ok = blk_readv(volume.blk, lba, segs, nsegs);
+        sector += run;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!ok) {
+            page_cache_drop(batch[i]);
+            continue;
+        }
+        // bytes past the end of file read as zero.
+        uint32_t page_start = (index + i) * PAGE_SIZE;
+        if (inode->size - page_start < PAGE_SIZE) {
+            uint32_t valid = inode->size - page_start;
+            memset((uint8_t *)batch[i]->data + valid, 0, PAGE_SIZE - valid);
+        }
+        batch[i]->flags |= PAGE_CACHE_VALID_F;
+    }
+
+    return ok ? batch[0] : 0;
+}
+
+page_cache_page *fat32_page(fat32_inode *inode, uint32_t index) {
+    if (index >= (inode->size + PAGE_SIZE - 1) / PAGE_SIZE) {
+        return 0;
+    }
+    page_cache_page *page = page_cache_lookup(inode->inode, index);
+    if (page) {
+        return page;
+    }
+    return fat32_fill(inode, index);
+}
+
+int32_t fat32_read(fat32_inode *inode, uint32_t offset, void *buffer,
+                   uint32_t size) {
+    if (!inode) {
+        return -1;
+    }
+    if (offset >= inode->size) {
+        return 0;
+    }
+    if (size > inode->size - offset) {
+        size = inode->size - offset;
+    }
+
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos & PAGE_ALIGN_MASK;
+
+        page_cache_page *page = fat32_page(inode, pos / PAGE_SIZE);
+        if (!page) {
+            return -1;
+        }
+
+        uint32_t n = PAGE_SIZE - in_page;
+        if (n > size - done) {
+            n = size - done;
+        }
+        memcpy((uint8_t *)buffer + done, (uint8_t *)page->data + in_page, n);
+        done += n;
+    }
+
+    return done;
+}
+
+uint8_t fat32_upper(char c) {
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 'A';
+    }
+    return c;
+}
+
+// Convert a path component of length `len` to a space padded 8.3 name.
+int fat32_short_name(const char *component, uint32_t len, uint8_t name[11]) {
+    memset(name, ' ', 11);
+
+    if ((len == 1 || len == 2) && component[0] == '.' &&
+        component[len - 1] == '.') {
+        memcpy(name, component, len);
+        return 1;
+    }
+
+    uint32_t dot = len;
+    for (uint32_t i = 0; i < len; i++) {
+        if (component[i] == '.') {
+            dot = i;
+        }
+    }
+    if (dot == 0 || dot > 8 || len - dot > 4) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < dot; i++) {
+        name[i] = fat32_upper(component[i]);
+    }
+    for (uint32_t i = dot + 1; i < len; i++) {
+        name[8 + i - dot - 1] = fat32_upper(component[i]);
+    }
+    return 1;
+}
+
+int fat32_find(fat32_inode *dir, const uint8_t name[11], fat32_dirent *out) {
+    fat32_dirent d;
+    for (uint32_t off = 0; fat32_read(dir, off, &d, sizeof(d)) == sizeof(d);
+         off += sizeof(d)) {
+        if (d.name[0] == FAT32_DIRENT_END) {
+            return 0;
+        }
+        if (d.name[0] == FAT32_DIRENT_FREE || d.attr == FAT32_ATTR_LFN ||
+            (d.attr & FAT32_ATTR_VOLUME_ID)) {
+            continue;
+        }
+
+        uint32_t i = 0;
+        while (i < 11 && d.name[i] == name[i]) {
+            i++;
+        }
+        if (i == 11) {
+            *out = d;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+fat32_inode *fat32_lookup(const char *path) {
+    if (!volume.mounted) {
+        return 0;
+    }
+
+    fat32_inode *inode =
+        fat32_iget(volume.root_cluster, 0, FAT32_ATTR_DIRECTORY);
+
+    while (inode && *path) {
+        while (*path == '/') {
+            path++;
+        }
+        if (!*path) {
+            break;
+        }
+
+        const char *component = path;
+        while (*path && *path != '/') {
+            path++;
+        }
+
+        uint8_t name[11];
+        fat32_dirent d;
+        if (!(inode->attr & FAT32_ATTR_DIRECTORY) ||
+            !fat32_short_name(component, path - component, name) ||
+            !fat32_find(inode, name, &d)) {
+            fat32_put(inode);
+            return 0;
+        }
+        fat32_put(inode);
+
+        uint32_t cluster = ((uint32_t)d.cluster_high << 16) | d.cluster_low;
+        // '..' of a first level directory refers to the root as cluster 0.
+        if (!cluster && (d.attr & FAT32_ATTR_DIRECTORY)) {
+            cluster = volume.root_cluster;
+        }
+        inode = fat32_iget(cluster, d.size, d.attr);
+    }
+
+    return inode;
+}
+
+int fat32_is_fat32_bpb(const fat32_bpb *bpb) {
+    const char *type = "FAT32   ";
+    for (uint32_t i = 0; i < sizeof(bpb->fs_type); i++) {
+        if (bpb->fs_type[i] != type[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int fat32_mount(blk_device *blk) {
+    uint8_t *sector = heap_zalloc(BLK_SECTOR_SIZE);
+    if (!sector) {
+        return 0;
+    }
+
+    int ok = 0;
+    uint32_t part_lba = 0;
+    if (!blk || !blk_read(blk, 0, 1, sector) ||
+        *(uint16_t *)(sector + 510) != FAT32_BOOT_SIGNATURE) {
+        goto out;
+    }
+
+    // a partitioned disk carries an MBR in its first sector, an unpartitioned
+    // one its FAT32 boot sector.
+    if (!fat32_is_fat32_bpb((fat32_bpb *)sector)) {
+        fat32_mbr_partition *parts =
+            (fat32_mbr_partition *)(sector + FAT32_MBR_PARTITION_OFFSET);
+        for (uint32_t i = 0; i < FAT32_MBR_PARTITION_COUNT; i++) {
+            if (parts[i].type == FAT32_MBR_TYPE_FAT32_CHS ||
+                parts[i].type == FAT32_MBR_TYPE_FAT32_LBA) {
+                part_lba = parts[i].lba_start;
+                break;
+            }
+        }
+        if (!part_lba ||
+            !blk_read(blk, part_lba, 1, sector)) {
+            goto out;
+        }
+    }
+
+    fat32_bpb *bpb = (fat32_bpb *)sector;
+    uint32_t spc = bpb->sectors_per_cluster;
+    if (*(uint16_t *)(sector + 510) != FAT32_BOOT_SIGNATURE ||
+        bpb->bytes_per_sector != BLK_SECTOR_SIZE || !spc ||
+        (spc & (spc - 1)) != 0 || !bpb->fat_size_32 || !bpb->fat_count) {
+        goto out;
+    }
+
+    memset(&volume, 0, sizeof(volume));
+    memset(inodes, 0, sizeof(inodes));
+    volume.blk = blk;
+    volume.part_lba = part_lba;
+    volume.fat_lba = part_lba + bpb->reserved_sectors;
+    volume.data_lba = volume.fat_lba + bpb->fat_count * bpb->fat_size_32;
+    volume.sectors_per_cluster = spc;
+    volume.clusters =
+        (bpb->total_sectors_32 - (volume.data_lba - part_lba)) / spc;
+    volume.root_cluster = bpb->root_cluster;
+    volume.mounted = 1;
+    ok = 1;
+
+out:
+    heap_free(sector);
+    return ok;
+}
@@ -0,0 +1,141 @@
+#ifndef FAT32_H
+#define FAT32_H
+
+#include <stdint.h>
+
+#include "../drivers/blk/blk.h"
+#include "page_cache.h"
+
+#define FAT32_MBR_PARTITION_OFFSET 0x1BE
+#define FAT32_MBR_PARTITION_COUNT 4
+#define FAT32_MBR_TYPE_FAT32_CHS 0x0B
+#define FAT32_MBR_TYPE_FAT32_LBA 0x0C
+#define FAT32_BOOT_SIGNATURE 0xAA55
+
+#define FAT32_CLUSTER_MASK 0x0FFFFFFF
+#define FAT32_CLUSTER_EOC 0x0FFFFFF8
+#define FAT32_CLUSTER_BAD 0x0FFFFFF7
+
+#define FAT32_ATTR_READ_ONLY 0x01
+#define FAT32_ATTR_HIDDEN 0x02
+#define FAT32_ATTR_SYSTEM 0x04
+#define FAT32_ATTR_VOLUME_ID 0x08
+#define FAT32_ATTR_DIRECTORY 0x10
+#define FAT32_ATTR_ARCHIVE 0x20
+#define FAT32_ATTR_LFN 0x0F
+
+#define FAT32_DIRENT_END 0x00
+#define FAT32_DIRENT_FREE 0xE5
+
+// Number of pages read in one go when a read misses the page cache.
+#define FAT32_READAHEAD_PAGES 16
+// Maximum number of inodes (and their extent maps) kept in memory.
+#define FAT32_MAX_INODES 64
+
+typedef struct fat32_mbr_partition {
+    uint8_t status;
+    uint8_t chs_first[3];
+    uint8_t type;
+    uint8_t chs_last[3];
+    uint32_t lba_start;
+    uint32_t sectors;
+} __attribute__((packed)) fat32_mbr_partition;
+
+// BIOS parameter block, including the FAT32 extended fields.
+typedef struct fat32_bpb {
+    uint8_t jump[3];
+    uint8_t oem[8];
+    uint16_t bytes_per_sector;
+    uint8_t sectors_per_cluster;
+    uint16_t reserved_sectors;
+    uint8_t fat_count;
+    uint16_t root_entries;
+    uint16_t total_sectors_16;
+    uint8_t media;
+    uint16_t fat_size_16;
+    uint16_t sectors_per_track;
+    uint16_t heads;
+    uint32_t hidden_sectors;
+    uint32_t total_sectors_32;
+    uint32_t fat_size_32;
+    uint16_t ext_flags;
+    uint16_t version;
+    uint32_t root_cluster;
+    uint16_t fs_info;
+    uint16_t backup_boot;
+    uint8_t reserved[12];
+    uint8_t drive;
+    uint8_t reserved1;
+    uint8_t boot_signature;
+    uint32_t volume_id;
+    uint8_t volume_label[11];
+    uint8_t fs_type[8];
+} __attribute__((packed)) fat32_bpb;
+
+typedef struct fat32_dirent {
+    uint8_t name[11];
+    uint8_t attr;
+    uint8_t nt_reserved;
+    uint8_t create_time_tenth;
+    uint16_t create_time;
+    uint16_t create_date;
+    uint16_t access_date;
+    uint16_t cluster_high;
+    uint16_t write_time;
+    uint16_t write_date;
+    uint16_t cluster_low;
+    uint32_t size;
+} __attribute__((packed)) fat32_dirent;
+
+// A run of `sectors` contiguous device sectors backing the file starting at
+// file relative sector `file_sector`.
+typedef struct fat32_extent {
+    uint32_t file_sector;
+    uint32_t lba;
+    uint32_t sectors;
+} fat32_extent;
+
+// In memory inode, the inode number is the file's first cluster.
+//
+// The cluster chain is walked once when the inode is loaded and cached as
+// extents, so mapping a file offset to a device sector never touches the FAT.
+typedef struct fat32_inode {
+    uint32_t inode;
+    uint32_t size;
+    uint8_t attr;
+    uint32_t refs;
+    fat32_extent *extents;
+    uint32_t extent_count;
+    uint32_t extent_capacity;
+} fat32_inode;
+
+// Mount the first FAT32 partition found on the given block device.
+//
+// A device without a partition table is mounted if its first sector holds a
+// FAT32 boot sector.
+int fat32_mount(blk_device *blk);
+
+// Resolve an absolute, '/' separated path to an inode.
+//
+// Path components are matched against the 8.3 short names of directory
+// entries, case insensitively. The returned inode must be released with
+// fat32_put.
+fat32_inode *fat32_lookup(const char *path);
+
+// Take an additional reference on an inode.
+fat32_inode *fat32_get(fat32_inode *inode);
+
+// Release an inode returned by fat32_lookup or fat32_get.
+void fat32_put(fat32_inode *inode);
+
+// Return the valid page cache page for page `index` of the inode, filling
+// it (with read ahead) on a miss. Returns 0 past the end of file or on error.
+page_cache_page *fat32_page(fat32_inode *inode, uint32_t index);
+
+// Read up to `size` bytes at `offset` from the inode through the page cache.
+//
+// Returns the number of bytes read, 0 at end of file, or -1 on error.
+int32_t fat32_read(fat32_inode *inode, uint32_t offset, void *buffer,
+                   uint32_t size);
+
+#endif  // FAT32_H
@@ -0,0 +1,108 @@
+#include "fs.h"
+
+#include <stdint.h>
+
+#include "../drivers/blk/blk.h"
+#include "../memory/memory.h"
+#include "../memory/mmap.h"
+#include "../memory/paging.h"
+#include "fat32.h"
+#include "page_cache.h"
+
+typedef struct fs_file {
+    fat32_inode *inode;
+    uint32_t offset;
+} fs_file;
+
+fs_file files[FS_MAX_OPEN_FILES];
+
+int fs_init() {
+    memset(files, 0, sizeof(files));
+    page_cache_init();
+    // the filesystem disk is the IDE secondary master, or the first virtio
+    // or AHCI disk when it is attached through one of those instead.
+    return fat32_mount(blk_find("ata2")) || fat32_mount(blk_find("vda")) ||
+           fat32_mount(blk_find("sda"));
+}
+
+fs_file *fs_get_file(int fd) {
+    if (fd < 0 || fd >= FS_MAX_OPEN_FILES || !files[fd].inode) {
+        return 0;
+    }
+    return &files[fd];
+}
+
+int fs_open(const char *path) {
+    for (int fd = 0; fd < FS_MAX_OPEN_FILES; fd++) {
+        if (files[fd].inode) {
+            continue;
+        }
+        fat32_inode *inode = fat32_lookup(path);
+        if (!inode) {
+            return -1;
+        }
+        files[fd].inode = inode;
+        files[fd].offset = 0;
+        return fd;
+    }
+    return -1;
+}
+
+int32_t fs_read(int fd, void *buffer, uint32_t size) {
+    fs_file *f = fs_get_file(fd);
+    if (!f) {
+        return -1;
+    }
+    int32_t n = fat32_read(f->inode, f->offset, buffer, size);
+    if (n > 0) {
+        f->offset += n;
+    }
+    return n;
+}
+
+int fs_stat(const char *path, fs_stat_info *st) {
+    fat32_inode *inode = fat32_lookup(path);
+    if (!inode) {
+        return 0;
+    }
+    st->inode = inode->inode;
+    st->size = inode->size;
+    st->directory = (inode->attr & FAT32_ATTR_DIRECTORY) != 0;
+    fat32_put(inode);
+    return 1;
+}
+
+page_cache_page *fs_mmap_get_page(void *ctx, uint32_t index) {
+    return fat32_page(ctx, index);
+}
+
+void fs_mmap_release(void *ctx) { fat32_put(ctx); }
+
+void *fs_mmap(int fd, uint32_t offset, uint32_t size) {
+    fs_file *f = fs_get_file(fd);
+    if (!f || (offset & PAGE_ALIGN_MASK) != 0 || offset >= f->inode->size) {
+        return 0;
+    }
+    if (size > f->inode->size - offset) {
+        size = f->inode->size - offset;
+    }
+
+    fat32_inode *inode = fat32_get(f->inode);
+    void *addr = mmap_create(inode->inode, offset / PAGE_SIZE,
+                             (size + PAGE_SIZE - 1) / PAGE_SIZE,
+                             fs_mmap_get_page, fs_mmap_release, inode);
+    if (!addr) {
+        fat32_put(inode);
+    }
+    return addr;
+}
+
+int fs_close(int fd) {
+    fs_file *f = fs_get_file(fd);
+    if (!f) {
+        return 0;
+    }
+    fat32_put(f->inode);
+    f->inode = 0;
+    return 1;
+}
@@ -0,0 +1,38 @@
+#ifndef FS_H
+#define FS_H
+
+#include <stdint.h>
+
+#define FS_MAX_OPEN_FILES 32
+
+typedef struct fs_stat_info {
+    uint32_t inode;
+    uint32_t size;
+    uint8_t directory;
+} fs_stat_info;
+
+// Mount the read-only root filesystem from the secondary ATA bus master
+// (block device "ata2").
+int fs_init();
+
+// Open the file at the absolute `path`, returns a file descriptor or -1.
+int fs_open(const char *path);
+
+// Read up to `size` bytes from the descriptor's current offset and advance
+// it, returns the number of bytes read, 0 at end of file, or -1 on error.
+int32_t fs_read(int fd, void *buffer, uint32_t size);
+
+// Fill `st` with the attributes of the file at `path`.
+int fs_stat(const char *path, fs_stat_info *st);
+
+// Map `size` bytes of the open file starting at the page aligned `offset`
+// into a read-only linear range, returns its start or 0 on error.
+//
+// Pages are read through the page cache on first access and the mapping
+// keeps the file referenced until it is released with mmap_destroy.
+void *fs_mmap(int fd, uint32_t offset, uint32_t size);
+
+// Close a descriptor returned by fs_open.
+int fs_close(int fd);
+
+#endif  // FS_H
@@ -0,0 +1,168 @@
+#include "page_cache.h"
+
+#include <stdint.h>
+
+#include "../memory/heap.h"
+#include "../memory/memory.h"
+#include "../memory/mmap.h"
+#include "../memory/paging.h"
+
+#if (PAGE_CACHE_HASH_SIZE & (PAGE_CACHE_HASH_SIZE - 1)) != 0
+#error "PAGE_CACHE_HASH_SIZE must be a power of two"
+#endif
+
+#define PAGE_CACHE_HASH(inode, index) \
+    (((inode) ^ ((index) * 2654435761u)) & (PAGE_CACHE_HASH_SIZE - 1))
+
+page_cache_page pages[PAGE_CACHE_MAX_PAGES];
+page_cache_page *buckets[PAGE_CACHE_HASH_SIZE];
+
+// Unused page slots, chained through `hash_next`.
+page_cache_page *free_pages;
+
+// Sentinel of the circular LRU list, `lru_next` is the most recently used
+// page and `lru_prev` the least recently used.
+page_cache_page lru;
+
+void page_cache_lru_unlink(page_cache_page *page) {
+    page->lru_prev->lru_next = page->lru_next;
+    page->lru_next->lru_prev = page->lru_prev;
+}
+
+void page_cache_lru_push(page_cache_page *page) {
+    page->lru_prev = &lru;
+    page->lru_next = lru.lru_next;
+    lru.lru_next->lru_prev = page;
+    lru.lru_next = page;
+}
+
+void page_cache_hash_unlink(page_cache_page *page) {
+    page_cache_page **p = &buckets[PAGE_CACHE_HASH(page->inode, page->index)];
+    while (*p && *p != page) {
+        p = &(*p)->hash_next;
+    }
+    if (*p) {
+        *p = page->hash_next;
+    }
+    page->hash_next = 0;
+}
+
+void page_cache_init() {
+    memset(pages, 0, sizeof(pages));
+    memset(buckets, 0, sizeof(buckets));
+
+    lru.lru_next = &lru;
+    lru.lru_prev = &lru;
+
+    free_pages = 0;
+    for (uint32_t i = 0; i < PAGE_CACHE_MAX_PAGES; i++) {
+        pages[i].hash_next = free_pages;
+        free_pages = &pages[i];
+    }
+}
+
+page_cache_page *page_cache_lookup(uint32_t inode, uint32_t index) {
+    page_cache_page *page = buckets[PAGE_CACHE_HASH(inode, index)];
+    for (; page; page = page->hash_next) {
+        if (page->inode == inode && page->index == index) {
+            page_cache_lru_unlink(page);
+            page_cache_lru_push(page);
+            return page;
+        }
+    }
+    return 0;
+}
+
+// Evict the least recently used page, returning its slot with the page data
+// still attached so it can be reused without a heap allocation.
+//
+// The scan covers the list twice, a first pass may only clear the accessed
+// bits of mapped pages, which makes them victims on the second.
+page_cache_page *page_cache_evict() {
+    for (uint32_t i = 0; i < 2 * PAGE_CACHE_MAX_PAGES; i++) {
+        page_cache_page *page = lru.lru_prev;
+        if (page == &lru) {
+            return 0;
+        }
+        page_cache_lru_unlink(page);
+
+        if (page->mapcount && mmap_page_referenced(page)) {
+            page_cache_lru_push(page);
+            continue;
+        }
+        if (page->mapcount) {
+            mmap_page_unmap(page);
+        }
+
+        page_cache_hash_unlink(page);
+        return page;
+    }
+    return 0;
+}
+
+page_cache_page *page_cache_alloc(uint32_t inode, uint32_t index) {
+    page_cache_page *page = free_pages;
+    if (page) {
+        free_pages = page->hash_next;
+        if (!page->data) {
+            page->data = heap_malloc(PAGE_SIZE);
+        }
+        if (!page->data) {
+            // heap is exhausted, give the slot back and reuse a cached page.
+            page->hash_next = free_pages;
+            free_pages = page;
+            page = 0;
+        }
+    }
+
+    if (!page) {
+        page = page_cache_evict();
+        if (!page) {
+            return 0;
+        }
+    }
+
+    page->inode = inode;
+    page->index = index;
+    page->flags = 0;
+    page->mapcount = 0;
+
+    uint32_t bucket = PAGE_CACHE_HASH(inode, index);
+    page->hash_next = buckets[bucket];
+    buckets[bucket] = page;
+    page_cache_lru_push(page);
+
+    return page;
+}
+
+void page_cache_drop(page_cache_page *page) {
+    if (page->mapcount) {
+        mmap_page_unmap(page);
+    }
+    page_cache_lru_unlink(page);
+    page_cache_hash_unlink(page);
+    page->flags = 0;
+    page->hash_next = free_pages;
+    free_pages = page;
+}
+
+page_cache_page *page_cache_device_page(blk_device *dev, uint32_t index) {
+    uint32_t inode = PAGE_CACHE_DEVICE_INODE(dev->id);
+
+    page_cache_page *page = page_cache_lookup(inode, index);
+    if (page) {
+        return page;
+    }
+
+    page = page_cache_alloc(inode, index);
+    if (!page) {
+        return 0;
+    }
+    if (!blk_read(dev, index * (PAGE_SIZE / BLK_SECTOR_SIZE),
+                  PAGE_SIZE / BLK_SECTOR_SIZE, page->data)) {
+        page_cache_drop(page);
+        return 0;
+    }
+    page->flags |= PAGE_CACHE_VALID_F;
+    return page;
+}
@@ -0,0 +1,61 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <stdint.h>
+
+#include "../drivers/blk/blk.h"
+
+// Maximum number of pages held by the cache (4MiB with 4KiB pages).
+#define PAGE_CACHE_MAX_PAGES 1024
+// Number of hash buckets, must be a power of two.
+#define PAGE_CACHE_HASH_SIZE 256
+
+// Page data has been filled from its backing store.
+#define PAGE_CACHE_VALID_F (1 << 0)
+
+// Inode numbers at or above this value name raw block devices (by their blk
+// registry id) rather than files, the device's page `index` is then its byte
+// offset / PAGE_SIZE.
+#define PAGE_CACHE_DEVICE_INODE_BASE 0xF0000000
+#define PAGE_CACHE_DEVICE_INODE(n) (PAGE_CACHE_DEVICE_INODE_BASE | (n))
+
+// A single cached page, indexed by (inode, index) where index is the page
+// sized offset into the inode's data.
+typedef struct page_cache_page {
+    uint32_t inode;
+    uint32_t index;
+    uint32_t flags;
+    // number of mmap regions mapping this page.
+    uint32_t mapcount;
+    void *data;
+    struct page_cache_page *hash_next;
+    struct page_cache_page *lru_prev;
+    struct page_cache_page *lru_next;
+} page_cache_page;
+
+void page_cache_init();
+
+// Return the cached page for (inode, index) or 0 if it is not cached.
+//
+// A successful lookup marks the page as most recently used.
+page_cache_page *page_cache_lookup(uint32_t inode, uint32_t index);
+
+// Allocate a page for (inode, index), evicting the least recently used page
+// when the cache is full or the heap is exhausted.
+//
+// Mapped pages are clean and may be evicted too, they are unmapped first
+// unless their accessed bit shows a recent use, which grants them a second
+// pass through the LRU list.
+//
+// The returned page is not valid, the caller fills `data` and sets
+// PAGE_CACHE_VALID_F, or hands it back with page_cache_drop on failure.
+page_cache_page *page_cache_alloc(uint32_t inode, uint32_t index);
+
+// Remove a page from the cache, returning its slot to the free list.
+void page_cache_drop(page_cache_page *page);
+
+// Return the valid page holding page `index` of a raw block device, reading
+// it from the device on a miss.
+page_cache_page *page_cache_device_page(blk_device *dev, uint32_t index);
+
+#endif  // PAGE_CACHE_H
@@ -0,0 +1,60 @@
+#include "gdt.h"
+
+#include <stdint.h>
+
+#include "memory/memory.h"
+
+gdt_descriptor gdt[GDT_ENTRIES] __attribute__((aligned(8)));
+gdtr_descriptor gdtr;
+gdt_tss tss;
+
+void gdt_set(uint16_t selector, uint32_t base, uint32_t limit, uint8_t access,
+             uint8_t flags) {
+    gdt_descriptor *d = &gdt[selector >> 3];
+    d->limit_low = limit & 0xFFFF;
+    d->base_low = base & 0xFFFF;
+    d->base_mid = (base >> 16) & 0xFF;
+    d->access = access;
+    d->limit_high_flags = ((limit >> 16) & 0xF) | (flags << 4);
+    d->base_high = (base >> 24) & 0xFF;
+}
+
+int gdt_init() {
+    memset(gdt, 0, sizeof(gdt));
+    memset(&tss, 0, sizeof(tss));
+
+    const uint8_t segment = GDT_ACCESS_PRESENT | GDT_ACCESS_SEGMENT;
+    gdt_set(GDT_KERNEL_CODE, 0, 0xFFFFF, segment | GDT_ACCESS_CODE,
+            GDT_FLAGS_FLAT);
+    gdt_set(GDT_KERNEL_DATA, 0, 0xFFFFF, segment | GDT_ACCESS_DATA,
+            GDT_FLAGS_FLAT);
+    gdt_set(GDT_USER_CODE, 0, 0xFFFFF,
+            segment | GDT_ACCESS_DPL3 | GDT_ACCESS_CODE, GDT_FLAGS_FLAT);
+    gdt_set(GDT_USER_DATA, 0, 0xFFFFF,
+            segment | GDT_ACCESS_DPL3 | GDT_ACCESS_DATA, GDT_FLAGS_FLAT);
+
+    tss.ss0 = GDT_KERNEL_DATA;
+    // no I/O permission bitmap, ring 3 gets no port access.
+    tss.iomap_base = sizeof(tss);
+    gdt_set(GDT_TSS, (uint32_t)&tss, sizeof(tss) - 1,
+            GDT_ACCESS_PRESENT | GDT_ACCESS_TSS, 0);
+
+    gdtr.limit = sizeof(gdt) - 1;
+    gdtr.base = (uint32_t)&gdt;
+    asm volatile("lgdt %0" : : "m"(gdtr));
+    asm volatile(
+        "ljmp %0, $1f\n"
+        "1:\n\t"
+        "mov %w1, %%ds\n\t"
+        "mov %w1, %%es\n\t"
+        "mov %w1, %%fs\n\t"
+        "mov %w1, %%gs\n\t"
+        "mov %w1, %%ss"
+        :
+        : "i"(GDT_KERNEL_CODE), "r"(GDT_KERNEL_DATA)
+        : "memory");
+    asm volatile("ltr %w0" : : "r"(GDT_TSS));
+    return 1;
+}
+
+void gdt_set_kernel_stack(uint32_t esp0) { tss.esp0 = esp0; }
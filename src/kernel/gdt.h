@@ -0,0 +1,62 @@
+#ifndef GDT_H
+#define GDT_H
+
+#include <stdint.h>
+
+// Segment selectors, the user selectors carry RPL 3. SYSENTER and SYSEXIT
+// derive their selectors from GDT_KERNEL_CODE and need this exact order.
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_USER_CODE 0x1B
+#define GDT_USER_DATA 0x23
+#define GDT_TSS 0x28
+
+#define GDT_ENTRIES 6
+
+// access byte flags.
+#define GDT_ACCESS_PRESENT 0x80
+#define GDT_ACCESS_DPL3 0x60
+#define GDT_ACCESS_SEGMENT 0x10
+#define GDT_ACCESS_CODE 0x0A  // execute/read
+#define GDT_ACCESS_DATA 0x02  // read/write
+#define GDT_ACCESS_TSS 0x09   // available 32 bit TSS
+
+// 4KiB granularity, 32 bit segment.
+#define GDT_FLAGS_FLAT 0xC
+
+typedef struct gdt_descriptor {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t base_mid;
+    uint8_t access;
+    uint8_t limit_high_flags;
+    uint8_t base_high;
+} __attribute__((packed)) gdt_descriptor;
+
+typedef struct gdtr_descriptor {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdtr_descriptor;
+
+// Only ss0:esp0, the stack loaded when an interrupt arrives in ring 3, is
+// used. Tasks are never switched in hardware.
+typedef struct gdt_tss {
+    uint32_t link;
+    uint32_t esp0;
+    uint32_t ss0;
+    uint32_t unused[22];
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) gdt_tss;
+
+// Load the kernel's GDT: flat ring 0 and ring 3 code and data segments and a
+// TSS, then reload the segment registers and the task register.
+//
+// Replaces the boot loader's GDT, which lives in low memory, so it must run
+// before paging_kernel_map's directory is loaded.
+int gdt_init();
+
+// Set the stack the CPU switches to on interrupts from ring 3.
+void gdt_set_kernel_stack(uint32_t esp0);
+
+#endif  // GDT_H
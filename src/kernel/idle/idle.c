@@ -0,0 +1,82 @@
+#include "idle.h"
+
+#include <stdint.h>
+
+#include "../cpu/cpu.h"
+#include "../drivers/serial/serial.h"
+
+idle_cpu idle_cpus[IDLE_MAX_CPUS];
+
+// Index of the running CPU.
+uint32_t idle_cpu_id() { return 0; }
+
+void idle_init() {
+    uint64_t now = cpu_rdtsc();
+    for (uint32_t i = 0; i < IDLE_MAX_CPUS; i++) {
+        idle_cpus[i] = (idle_cpu){.busy_since = now};
+    }
+}
+
+void idle_wait() {
+    idle_cpu *c = &idle_cpus[idle_cpu_id()];
+    uint64_t start = cpu_rdtsc();
+    c->busy_cycles += start - c->busy_since;
+
+    // sti only takes effect after the next instruction, an interrupt pending
+    // here wakes the hlt rather than slipping in before it.
+    asm volatile(
+        "sti\n\t"
+        "hlt\n\t"
+        "cli"
+        :
+        :
+        : "memory");
+
+    uint64_t end = cpu_rdtsc();
+    c->idle_cycles += end - start;
+    c->wakeups++;
+    c->busy_since = end;
+}
+
+void idle_loop() {
+    cpu_irq_save();
+    while (1) {
+        idle_wait();
+    }
+}
+
+const idle_cpu *idle_get_cpu(uint32_t cpu) {
+    if (cpu >= IDLE_MAX_CPUS) {
+        return 0;
+    }
+    return &idle_cpus[cpu];
+}
+
+void idle_dump() {
+    uint64_t now = cpu_rdtsc();
+    for (uint32_t i = 0; i < IDLE_MAX_CPUS; i++) {
+        idle_cpu *c = &idle_cpus[i];
+        uint64_t idle = c->idle_cycles;
+        uint64_t busy = c->busy_cycles + (now - c->busy_since);
+
+        // scale both down until the percentage is a 32 bit division.
+        uint64_t total = idle + busy;
+        while (total >> 25) {
+            idle >>= 1;
+            total >>= 1;
+        }
+        uint32_t pct = total ? (uint32_t)idle * 100 / (uint32_t)total : 0;
+
+        serial_write_str("idle: cpu=");
+        serial_write_dec(i);
+        serial_write_str(" idle_cycles=");
+        serial_write_dec(c->idle_cycles);
+        serial_write_str(" busy_cycles=");
+        serial_write_dec(busy);
+        serial_write_str(" wakeups=");
+        serial_write_dec(c->wakeups);
+        serial_write_str(" idle_pct=");
+        serial_write_dec(pct);
+        serial_write_str("\n");
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+// CPUs with accounting slots, only the boot CPU runs today.
+#define IDLE_MAX_CPUS 1
+
+// Time spent halted and running, in TSC cycles, since idle_init.
+typedef struct idle_cpu {
+    uint64_t idle_cycles;
+    uint64_t busy_cycles;
+    uint64_t wakeups;
+    // TSC when the CPU last went from idle to busy.
+    uint64_t busy_since;
+} idle_cpu;
+
+// Start accounting, the time before counts as neither idle nor busy.
+void idle_init();
+
+// Halt until the next interrupt, counting the wait as idle time. Must be
+// called with interrupts disabled, they are enabled for the halt only.
+//
+// Callers check their wake condition with interrupts disabled and wait in a
+// loop, so a wakeup arriving before the halt is never lost:
+//
+//   uint32_t flags = cpu_irq_save();
+//   while (!done) {
+//       idle_wait();
+//   }
+//   cpu_irq_restore(flags);
+//
+// Interrupt handlers run before idle_wait returns and are counted as idle.
+void idle_wait();
+
+// Idle forever with interrupts enabled, for when there is nothing left to
+// run.
+void idle_loop() __attribute__((noreturn));
+
+// Accounting of CPU `cpu`, 0 if there is no such CPU.
+const idle_cpu *idle_get_cpu(uint32_t cpu);
+
+// Print the accounting over serial, one line per CPU:
+//
+//   idle: cpu=<n> idle_cycles=<n> busy_cycles=<n> wakeups=<n> idle_pct=<n>
+void idle_dump();
+
+#endif  // IDLE_H
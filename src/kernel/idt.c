@@ -1,31 +1,33 @@
 #include "idt.h"
 
+#include "cpu/cpu.h"
 #include "drivers/pic/pic.h"
 #include "drivers/vga/vga.h"
+#include "gdt.h"
 #include "io/io.h"
 #include "memory/memory.h"
+#include "memory/mmap.h"
+#include "proc/process.h"
 
 // interrupt descriptor table
 idt_descriptor idt[IDT_MAX_INTERRUPTS] __attribute__((aligned(8)));
 idtr_descriptor idtr;
 
-#define idt_handler(name, handler)       \
-    __attribute__((naked)) void name() { \
-        asm volatile("pusha");           \
-        asm volatile("push %esp");       \
-        asm volatile("call " #handler);  \
-        asm volatile("add $4, %esp");    \
-        asm volatile("popa");            \
-        asm volatile("iret");            \
-    }
-
 void idt_no_interrupt() { io_out8(PIC_MASTER_CMD_PORT, 0x20); };
 idt_handler(idt_handler_no_interrupt, idt_no_interrupt);
 
+// Unhandled IRQs from the slave PIC must be acknowledged on both controllers
+// or the slave stops delivering interrupts.
+void idt_no_interrupt_slave() { pic_eoi(8); };
+idt_handler(idt_handler_no_interrupt_slave, idt_no_interrupt_slave);
+
 void halt() {
     vga_write_str("System halted.\n", VGA_DEFAULT_CHAR);
+    // with interrupts off only an NMI ends the hlt.
+    cpu_irq_save();
     while (1) {
-    };
+        asm volatile("hlt");
+    }
 }
 
 void idt_div_by_zero(uint32_t *stack) {
@@ -46,30 +48,70 @@ void idt_div_by_zero(uint32_t *stack) {
     // EDI (4 bytes)	|_________________| <-- *stack
     //
     // therefore to get to EIP we must walk up the stack 8 times, scaling by
-    // 32bits
+    // 32bits. CS follows EIP, and interrupts taken in ring 3 push the user's
+    // ESP and SS above EFLAGS.
+    if (*(stack + 9) & 3) {
+        process_exit(PROCESS_EXIT_FAULT);
+    }
     *(stack + 8) = (uint32_t)halt;
 }
 idt_handler(idt_handler_div_by_zero, idt_div_by_zero);
 
+void idt_page_fault(uint32_t *stack) {
+    uint32_t addr;
+    asm volatile("mov %%cr2, %0" : "=r"(addr));
+
+    // the error code is pushed below EIP, so it sits at *(stack + 8) and EIP
+    // at *(stack + 9), see idt_div_by_zero for the rest of the layout.
+    // mmap regions belong to the kernel, user faults never fill them.
+    int user = *(stack + 10) & 3;
+    if (!user && mmap_fault(addr, *(stack + 8))) {
+        return;
+    }
+    vga_write_str("Page fault\n", VGA_DEFAULT_CHAR);
+    if (user) {
+        process_exit(PROCESS_EXIT_FAULT);
+    }
+    *(stack + 9) = (uint32_t)halt;
+}
+idt_handler_err(idt_handler_page_fault, idt_page_fault);
+
+// Privileged instructions and gates user code may not raise end up here.
+void idt_general_protection(uint32_t *stack) {
+    vga_write_str("General protection fault\n", VGA_DEFAULT_CHAR);
+    if (*(stack + 10) & 3) {
+        process_exit(PROCESS_EXIT_FAULT);
+    }
+    *(stack + 9) = (uint32_t)halt;
+}
+idt_handler_err(idt_handler_general_protection, idt_general_protection);
+
 void idt_int21_keyboard(uint32_t *stack) {
     vga_write_str("Keyboard interrupt received\n", VGA_DEFAULT_CHAR);
     io_out8(PIC_MASTER_CMD_PORT, 0x20);
 }
 idt_handler(idt_handler_int21_keyboard, idt_int21_keyboard);
 
-// set the interrupt handler address for the given interrupt number.
-int idt_set(uint16_t interrupt_num, void *address) {
+int idt_set_gate(uint16_t interrupt_num, void *address, uint8_t type_attr) {
     if (interrupt_num >= IDT_MAX_INTERRUPTS) {
         return 0;
     }
     idt_descriptor *d = &idt[interrupt_num];
     d->offset_1 = (uint32_t)address & 0xFFFF;
-    d->selector = 0x08;
-    d->type_attr = 0xEE;
+    d->selector = GDT_KERNEL_CODE;
+    d->type_attr = type_attr;
     d->offset_2 = ((uint32_t)address >> 16) & 0xFFFF;
     return 0;
 }
 
+int idt_set(uint16_t interrupt_num, void *address) {
+    return idt_set_gate(interrupt_num, address, IDT_GATE_KERNEL);
+}
+
+int idt_set_user(uint16_t interrupt_num, void *address) {
+    return idt_set_gate(interrupt_num, address, IDT_GATE_USER);
+}
+
 void idt_set_idtr() {
     idtr.limit = (sizeof(idt_descriptor) * IDT_MAX_INTERRUPTS) - 1;
     idtr.base = (uint32_t)&idt;
@@ -83,8 +125,13 @@ int idt_init() {
     for (uint16_t i = 0; i < IDT_MAX_INTERRUPTS; i++) {
         idt_set(i, idt_handler_no_interrupt);
     }
+    for (uint16_t i = PIC_SLAVE_OFFSET; i < PIC_SLAVE_OFFSET + 8; i++) {
+        idt_set(i, idt_handler_no_interrupt_slave);
+    }
 
     idt_set(0, idt_handler_div_by_zero);
+    idt_set(13, idt_handler_general_protection);
+    idt_set(14, idt_handler_page_fault);
     idt_set(0x21, idt_handler_int21_keyboard);
 
     idt_set_idtr();
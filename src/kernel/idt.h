@@ -5,6 +5,11 @@
 
 #define IDT_MAX_INTERRUPTS 256
 
+// present 32 bit interrupt gates, only DPL 3 gates may be raised with `int`
+// from ring 3.
+#define IDT_GATE_KERNEL 0x8E
+#define IDT_GATE_USER 0xEE
+
 // The structures which comprise the interrupt descriptor table.
 // Each `idt_descriptor`'s location within the table reflects the interrupt
 // number it handles.
@@ -23,7 +28,43 @@ typedef struct idtr_descriptor {
     uint32_t base;
 } __attribute__((packed)) idtr_descriptor;
 
+// Wrap a C `handler(uint32_t *stack)` in an interrupt entry point which saves
+// the general purpose registers and returns with iret.
+#define idt_handler(name, handler)       \
+    __attribute__((naked)) void name() { \
+        asm volatile("pusha");           \
+        asm volatile("push %esp");       \
+        asm volatile("call " #handler);  \
+        asm volatile("add $4, %esp");    \
+        asm volatile("popa");            \
+        asm volatile("iret");            \
+    }
+
+// Variant of idt_handler for exceptions which push an error code, the code
+// sits between the pusha frame and the interrupt stack and is dropped before
+// returning.
+#define idt_handler_err(name, handler)   \
+    __attribute__((naked)) void name() { \
+        asm volatile("pusha");           \
+        asm volatile("push %esp");       \
+        asm volatile("call " #handler);  \
+        asm volatile("add $4, %esp");    \
+        asm volatile("popa");            \
+        asm volatile("add $4, %esp");    \
+        asm volatile("iret");            \
+    }
 
 int idt_init();
 
+// Report the system as halted and stop the CPU with interrupts disabled,
+// exception handlers point the interrupted EIP here for faults they cannot
+// recover from.
+void halt() __attribute__((noreturn));
+
+// set the interrupt handler address for the given interrupt number.
+int idt_set(uint16_t interrupt_num, void *address);
+
+// like idt_set, but user code may raise the interrupt with `int`.
+int idt_set_user(uint16_t interrupt_num, void *address);
+
 #endif  // IDT_H
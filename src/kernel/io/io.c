@@ -16,6 +16,14 @@ uint16_t io_ins16(uint16_t port) {
 	return word;
 }
 
+uint32_t io_ins32(uint16_t port) {
+	uint32_t dword;
+
+	asm volatile("inl %1, %0" : "=a"(dword) : "d"(port));
+
+	return dword;
+}
+
 void io_out8(uint16_t port, uint8_t value) {
 	asm volatile("outb %1, %0" : : "d"(port), "a"(value));
 }
@@ -23,3 +31,7 @@ void io_out8(uint16_t port, uint8_t value) {
 void io_out16(uint16_t port, uint16_t value) {
 	asm volatile("outw %1, %0" : : "d"(port), "a"(value));
 }
+
+void io_out32(uint16_t port, uint32_t value) {
+	asm volatile("outl %1, %0" : : "d"(port), "a"(value));
+}
@@ -1,20 +1,67 @@
 ; kernel runs in 32 bit mode
 [BITS 32]
 
-CODE_SEGMENT equ 0x08
 DATA_SEGMENT equ 0x10
 
+; The kernel is linked in the higher half and loaded 1MiB into physical
+; memory (see kernel.lds), until paging is on symbols are translated by hand.
+KERNEL_BASE equ 0xC0000000
+KERNEL_STACK_TOP equ KERNEL_BASE + 0x300000
+
+; The boot directory maps the first 128MiB with 4MiB pages at 0 and at
+; KERNEL_BASE, the identity half only keeps the code running across enabling
+; paging. kernel_main replaces it with paging_kernel_map's directory.
+;
+; PSE is not checked for, every CPU since the Pentium has it and the second
+; stage already relies on the Pentium's rdtsc.
+BOOT_MAP_PDES equ 32
+BOOT_PDE_FLAGS equ 0x83 ; present | rw | 4MiB page
+KERNEL_PDE equ KERNEL_BASE >> 22
+CR4_PSE equ 1 << 4
+CR0_PG equ 1 << 31
+
+section .data align=4096
+; in .data rather than .bss, zero_bss would clear it under our feet.
+boot_page_directory:
+	times 1024 dd 0
+
+section .text
 extern kernel_main
 global _start
 _start:
-	; configure environment for C
+	mov edi, boot_page_directory - KERNEL_BASE
+	mov eax, BOOT_PDE_FLAGS
+	xor ecx, ecx
+.map:
+	mov [edi + ecx * 4], eax
+	mov [edi + ecx * 4 + KERNEL_PDE * 4], eax
+	add eax, 0x400000
+	inc ecx
+	cmp ecx, BOOT_MAP_PDES
+	jne .map
+
+	mov eax, cr4
+	or eax, CR4_PSE
+	mov cr4, eax
+	mov cr3, edi
+	mov eax, cr0
+	or eax, CR0_PG
+	mov cr0, eax
+
+	; continue at the linked address.
+	mov eax, higher_half
+	jmp eax
+
+higher_half:
+	; configure environment for C, the boot loader's segments stay loaded
+	; until gdt_init replaces its GDT.
 	mov ax, DATA_SEGMENT
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
 	mov gs, ax
 	mov ss, ax
-	mov ebp, 0x300000
+	mov ebp, KERNEL_STACK_TOP
 	mov esp, ebp
 	call kernel_main         ; call the C main function
 
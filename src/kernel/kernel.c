@@ -1,9 +1,27 @@
+#include "bench/bench.h"
+#include "boot_info.h"
+#include "checksum/checksum.h"
+#include "cpu/fpu.h"
+#include "drivers/ahci/ahci.h"
 #include "drivers/ata/ata.h"
+#include "drivers/blk/blk.h"
 #include "drivers/pic/pic.h"
+#include "drivers/pit/pit.h"
+#include "drivers/serial/serial.h"
 #include "drivers/vga/vga.h"
+#include "drivers/virtio/virtio_blk.h"
+#include "fs/fs.h"
+#include "gdt.h"
+#include "idle/idle.h"
 #include "idt.h"
+#include "memory/memory.h"
 #include "memory/heap.h"
 #include "memory/paging.h"
+#include "proc/process.h"
+#include "proc/user.h"
+#include "profiler/profiler.h"
+#include "syscall/syscall.h"
+#include "timer/timer.h"
 
 // bss_start points to the first byte of the bss section.
 extern uint8_t bss_start;
@@ -18,33 +36,125 @@ void zero_bss() {
     }
 }
 
+// Report how the boot loader loaded the kernel over serial.
+void report_boot_info() {
+    const boot_info *info = MEMORY_VIRT(BOOT_INFO_ADDR);
+    if (info->magic != BOOT_INFO_MAGIC) {
+        return;
+    }
+    serial_write_str("boot: kernel read=");
+    serial_write_dec(info->disk_bytes);
+    serial_write_str(" decompressed=");
+    serial_write_dec(info->image_bytes);
+    serial_write_str(" memory=");
+    serial_write_dec(info->memory_bytes);
+    serial_write_str(" cycles=");
+    serial_write_dec(info->tsc_end - info->tsc_start);
+    serial_write_str("\n");
+}
+
+// Run the built-in user program in ring 3.
+void run_user_hello() {
+    process *p = process_create(user_hello_start,
+                                user_hello_end - user_hello_start);
+    if (!p) {
+        vga_write_str("Failed to create user process\n", VGA_DEFAULT_CHAR);
+        return;
+    }
+    int32_t code = process_run(p);
+    process_destroy(p);
+    serial_write_str("process: exit code=");
+    if (code < 0) {
+        serial_write_char('-');
+        code = -code;
+    }
+    serial_write_dec(code);
+    serial_write_str("\n");
+    syscall_dump();
+}
+
 void kernel_main() {
     vga_write_str("Initializing kernel...\n", VGA_DEFAULT_CHAR);
 
     zero_bss();
     vga_write_str("BSS section zeroed\n", VGA_DEFAULT_CHAR);
 
+    gdt_init();
+    vga_write_str("GDT loaded\n", VGA_DEFAULT_CHAR);
+
     if (!idt_init()) {
         vga_write_str("Failed to initialize IDT\n", VGA_DEFAULT_CHAR);
-        while (1);
+        halt();
     }
     vga_write_str("IDT initialized\n", VGA_DEFAULT_CHAR);
 
+    if (fpu_init()) {
+        vga_write_str("FPU initialized\n", VGA_DEFAULT_CHAR);
+    } else {
+        vga_write_str("No FXSAVE support, SIMD disabled\n", VGA_DEFAULT_CHAR);
+    }
+    checksum_init();
+
     pic_init();
     vga_write_str("PIC initialized\n", VGA_DEFAULT_CHAR);
 
     heap_init();
     vga_write_str("Heap initialized\n", VGA_DEFAULT_CHAR);
 
+    serial_init();
+    report_boot_info();
+    if (!syscall_init()) {
+        vga_write_str("Failed to initialize system calls\n", VGA_DEFAULT_CHAR);
+    }
+    pit_init();
+    if (!timer_init()) {
+        vga_write_str("Failed to calibrate the TSC\n", VGA_DEFAULT_CHAR);
+        halt();
+    }
+    idle_init();
+    profiler_init();
+
+#ifdef KERNEL_PROFILE
+    // profile the rest of the boot, built with `make PROFILE=1`.
+    profiler_start(PROFILER_DEFAULT_HZ);
+#endif
+
+    // replaces the boot page directory from kernel.asm, which also identity
+    // maps low memory.
     void *table =
-        paging_identity_map(0x08000000, PAGING_PRESENT_F | PAGING_RW_F);
+        paging_kernel_map(0x08000000, PAGING_PRESENT_F | PAGING_RW_F);
+    if (!table) {
+        vga_write_str("Failed to map kernel memory\n", VGA_DEFAULT_CHAR);
+        halt();
+    }
     paging_set_directory_table(table);
     paging_enable();
     vga_write_str("Paging enabled\n", VGA_DEFAULT_CHAR);
 
+    blk_init();
     ata_init();
+    ahci_init();
+    virtio_blk_init();
 
-    while (1) {
-        // Spin forever
+    if (!fs_init()) {
+        vga_write_str("Failed to mount filesystem\n", VGA_DEFAULT_CHAR);
+    } else {
+        vga_write_str("Filesystem mounted\n", VGA_DEFAULT_CHAR);
     }
+
+    run_user_hello();
+
+#ifdef KERNEL_PROFILE
+    profiler_stop();
+    profiler_dump();
+#endif
+
+#ifdef KERNEL_BENCH
+    // built by `make bench`, QEMU exits once the suite is done.
+    bench_exit(bench_run() ? BENCH_EXIT_SUCCESS : BENCH_EXIT_FAILURE);
+#endif
+
+    blk_dump();
+    idle_dump();
+    idle_loop();
 }
@@ -18,8 +18,8 @@
 
 // number of pages in heap
 #define HEAP_PAGE_COUNT (HEAP_SIZE / HEAP_PAGE_SIZE)
-// heap starts at 16MiB boundary
-#define HEAP_START 0x1000000
+// heap starts at the 16MiB physical boundary, in the kernel's direct map
+#define HEAP_START (MEMORY_KERNEL_BASE + 0x1000000)
 
 typedef union {
     uint8_t byte;
@@ -1,9 +1,106 @@
+#include "memory.h"
+
 #include <stdint.h>
 
+#include "../cpu/fpu.h"
+
+// Fill `size` bytes with SSE2 stores, 64 bytes per iteration once `ptr` is
+// aligned. Only valid inside a kernel_fpu_begin section.
+__attribute__((target("sse2"))) void memory_set_sse2(void *ptr, uint8_t c,
+                                                     uint32_t size) {
+    uint8_t *p = (uint8_t *)ptr;
+    uint8_t *end = p + size;
+    for (; ((uint32_t)p & MEMORY_SIMD_ALIGN_MASK) && p < end; p++) {
+        *p = c;
+    }
+
+    uint32_t pattern = c * 0x01010101u;
+    uint32_t blocks = (uint32_t)(end - p) / MEMORY_SIMD_BLOCK;
+    if (blocks) {
+        asm volatile(
+            "movd %2, %%xmm0\n\t"
+            "pshufd $0, %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movdqa %%xmm0, (%0)\n\t"
+            "movdqa %%xmm0, 16(%0)\n\t"
+            "movdqa %%xmm0, 32(%0)\n\t"
+            "movdqa %%xmm0, 48(%0)\n\t"
+            "add $64, %0\n\t"
+            "dec %1\n\t"
+            "jnz 1b"
+            : "+r"(p), "+r"(blocks)
+            : "r"(pattern)
+            : "xmm0", "memory");
+    }
+
+    for (; p < end; p++) {
+        *p = c;
+    }
+}
+
+// Copy `size` bytes with SSE2, unaligned loads and aligned stores once `dst`
+// is aligned. Only valid inside a kernel_fpu_begin section.
+__attribute__((target("sse2"))) void memory_copy_sse2(void *dst,
+                                                      const void *src,
+                                                      uint32_t size) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t *end = d + size;
+    for (; ((uint32_t)d & MEMORY_SIMD_ALIGN_MASK) && d < end; d++, s++) {
+        *d = *s;
+    }
+
+    uint32_t blocks = (uint32_t)(end - d) / MEMORY_SIMD_BLOCK;
+    if (blocks) {
+        asm volatile(
+            "1:\n\t"
+            "movdqu (%1), %%xmm0\n\t"
+            "movdqu 16(%1), %%xmm1\n\t"
+            "movdqu 32(%1), %%xmm2\n\t"
+            "movdqu 48(%1), %%xmm3\n\t"
+            "movdqa %%xmm0, (%0)\n\t"
+            "movdqa %%xmm1, 16(%0)\n\t"
+            "movdqa %%xmm2, 32(%0)\n\t"
+            "movdqa %%xmm3, 48(%0)\n\t"
+            "add $64, %0\n\t"
+            "add $64, %1\n\t"
+            "dec %2\n\t"
+            "jnz 1b"
+            : "+r"(d), "+r"(s), "+r"(blocks)
+            :
+            : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+    }
+
+    for (; d < end; d++, s++) {
+        *d = *s;
+    }
+}
+
 void *memset(void *ptr, uint8_t c, uint32_t size) {
+    if (size >= MEMORY_SIMD_MIN_SIZE && kernel_fpu_begin()) {
+        memory_set_sse2(ptr, c, size);
+        kernel_fpu_end();
+        return ptr;
+    }
+
     uint8_t *p = (uint8_t *)ptr;
     for (; p < ((uint8_t *)ptr + size); p++) {
         *p = c;
     }
     return ptr;
 }
+
+void *memcpy(void *dst, const void *src, uint32_t size) {
+    if (size >= MEMORY_SIMD_MIN_SIZE && kernel_fpu_begin()) {
+        memory_copy_sse2(dst, src, size);
+        kernel_fpu_end();
+        return dst;
+    }
+
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    for (uint32_t i = 0; i < size; i++) {
+        d[i] = s[i];
+    }
+    return dst;
+}
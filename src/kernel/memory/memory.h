@@ -3,6 +3,24 @@
 
 #include <stdint.h>
 
+// The kernel runs in the higher half, physical memory from 0 is mapped at
+// MEMORY_KERNEL_BASE in every address space (see paging_kernel_map).
+#define MEMORY_KERNEL_BASE 0xC0000000
+
+// Translate between kernel virtual and physical addresses, for handing
+// buffers to devices and walking page tables.
+#define MEMORY_PHYS(ptr) ((uint32_t)(ptr) - MEMORY_KERNEL_BASE)
+#define MEMORY_VIRT(addr) ((void *)((uint32_t)(addr) + MEMORY_KERNEL_BASE))
+
+// memset and memcpy switch to SSE2 from this size on, when kernel_fpu_begin
+// grants the registers. Below it claiming the FPU costs more than it saves.
+#define MEMORY_SIMD_MIN_SIZE 256
+#define MEMORY_SIMD_BLOCK 64
+#define MEMORY_SIMD_ALIGN_MASK 0xF
+
 void *memset(void *ptr, uint8_t c, uint32_t size);
 
+// Copy `size` bytes from `src` to `dst`, the regions must not overlap.
+void *memcpy(void *dst, const void *src, uint32_t size);
+
 #endif  // MEMORY_H
@@ -0,0 +1,187 @@
+#include "mmap.h"
+
+#include <stdint.h>
+
+#include "memory.h"
+#include "paging.h"
+
+mmap_region regions[MMAP_MAX_REGIONS];
+
+mmap_region *mmap_find(uint32_t addr) {
+    for (uint32_t i = 0; i < MMAP_MAX_REGIONS; i++) {
+        mmap_region *r = &regions[i];
+        if (r->used && addr >= r->start && addr - r->start < r->size) {
+            return r;
+        }
+    }
+    return 0;
+}
+
+// First fit search of the mmap window for `size` free bytes.
+uint32_t mmap_find_hole(uint32_t size) {
+    uint32_t start = MMAP_BASE;
+again:
+    if (size > MMAP_END - start) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < MMAP_MAX_REGIONS; i++) {
+        mmap_region *r = &regions[i];
+        if (r->used && start < r->start + r->size &&
+            r->start < start + size) {
+            start = r->start + r->size;
+            goto again;
+        }
+    }
+    return start;
+}
+
+void *mmap_create(uint32_t inode, uint32_t first_index, uint32_t pages,
+                  mmap_get_page_fn get_page, mmap_release_fn release,
+                  void *ctx) {
+    if (!pages || pages > (MMAP_END - MMAP_BASE) / PAGE_SIZE) {
+        return 0;
+    }
+
+    mmap_region *r = 0;
+    for (uint32_t i = 0; i < MMAP_MAX_REGIONS; i++) {
+        if (!regions[i].used) {
+            r = &regions[i];
+            break;
+        }
+    }
+    if (!r) {
+        return 0;
+    }
+
+    uint32_t start = mmap_find_hole(pages * PAGE_SIZE);
+    if (!start) {
+        return 0;
+    }
+
+    r->used = 1;
+    r->start = start;
+    r->size = pages * PAGE_SIZE;
+    r->inode = inode;
+    r->first_index = first_index;
+    r->pages = pages;
+    r->get_page = get_page;
+    r->release = release;
+    r->ctx = ctx;
+    return (void *)start;
+}
+
+page_cache_page *mmap_device_get_page(void *ctx, uint32_t index) {
+    return page_cache_device_page(ctx, index);
+}
+
+void *mmap_device(blk_device *dev, uint32_t lba, uint32_t size) {
+    const uint32_t sectors_per_page = PAGE_SIZE / BLK_SECTOR_SIZE;
+    if (!dev || lba % sectors_per_page != 0 || lba >= dev->sectors) {
+        return 0;
+    }
+    // only whole pages inside the device can be filled, sectors_per_page is
+    // 8 so shift rather than pull in 64-bit division.
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t device_pages = (dev->sectors - lba) >> 3;
+    if (pages > device_pages) {
+        pages = device_pages;
+    }
+    return mmap_create(PAGE_CACHE_DEVICE_INODE(dev->id),
+                       lba / sectors_per_page, pages, mmap_device_get_page, 0,
+                       dev);
+}
+
+int mmap_destroy(void *addr) {
+    mmap_region *r = mmap_find((uint32_t)addr);
+    if (!r || r->start != (uint32_t)addr) {
+        return 0;
+    }
+
+    page_directory_entry *table = paging_get_directory_table();
+    for (uint32_t i = 0; i < r->pages; i++) {
+        uint32_t linear = r->start + i * PAGE_SIZE;
+        page_table_entry *pte = paging_get_entry(table, linear);
+        if (!pte || !pte->s.present) {
+            continue;
+        }
+        page_cache_page *page = page_cache_lookup(r->inode, r->first_index + i);
+        if (page && page->mapcount) {
+            page->mapcount--;
+        }
+        paging_unmap(table, linear, PAGE_SIZE);
+    }
+
+    if (r->release) {
+        r->release(r->ctx);
+    }
+    memset(r, 0, sizeof(mmap_region));
+    return 1;
+}
+
+int mmap_fault(uint32_t addr, uint32_t error) {
+    mmap_region *r = mmap_find(addr);
+    // regions are read-only, writes and protection faults are errors.
+    if (!r || (error & (MMAP_FAULT_PRESENT_F | MMAP_FAULT_WRITE_F))) {
+        return 0;
+    }
+
+    uint32_t linear = addr & ~PAGE_ALIGN_MASK;
+    page_cache_page *page =
+        r->get_page(r->ctx, r->first_index + (linear - r->start) / PAGE_SIZE);
+    if (!page) {
+        return 0;
+    }
+
+    if (!paging_remap(paging_get_directory_table(), linear,
+                      MEMORY_PHYS(page->data), PAGE_SIZE, PAGING_PRESENT_F,
+                      false)) {
+        return 0;
+    }
+    page->mapcount++;
+    return 1;
+}
+
+// Call `fn` for the page table entry of every mapping of `page`.
+int mmap_for_each_mapping(page_cache_page *page,
+                          int (*fn)(page_table_entry *, uint32_t)) {
+    page_directory_entry *table = paging_get_directory_table();
+    int ret = 0;
+    for (uint32_t i = 0; i < MMAP_MAX_REGIONS; i++) {
+        mmap_region *r = &regions[i];
+        if (!r->used || r->inode != page->inode ||
+            page->index < r->first_index ||
+            page->index - r->first_index >= r->pages) {
+            continue;
+        }
+        uint32_t linear = r->start + (page->index - r->first_index) * PAGE_SIZE;
+        page_table_entry *pte = paging_get_entry(table, linear);
+        if (pte && pte->s.present) {
+            ret |= fn(pte, linear);
+        }
+    }
+    return ret;
+}
+
+int mmap_pte_referenced(page_table_entry *pte, uint32_t linear) {
+    if (!pte->s.accessed) {
+        return 0;
+    }
+    pte->s.accessed = 0;
+    paging_invalidate_page(linear);
+    return 1;
+}
+
+int mmap_pte_unmap(page_table_entry *pte, uint32_t linear) {
+    pte->i = 0;
+    paging_invalidate_page(linear);
+    return 0;
+}
+
+int mmap_page_referenced(page_cache_page *page) {
+    return mmap_for_each_mapping(page, mmap_pte_referenced);
+}
+
+void mmap_page_unmap(page_cache_page *page) {
+    mmap_for_each_mapping(page, mmap_pte_unmap);
+    page->mapcount = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef MMAP_H
+#define MMAP_H
+
+#include <stdint.h>
+
+#include "../fs/page_cache.h"
+#include "paging.h"
+
+// Linear address window handed out to mmap regions. It lies in the kernel
+// half, whose page tables every address space shares, so a region's PTEs are
+// the same whichever directory is loaded.
+#define MMAP_BASE PAGING_MMAP_BASE
+#define MMAP_END PAGING_MMAP_END
+#define MMAP_MAX_REGIONS 16
+
+// page fault error code bits.
+#define MMAP_FAULT_PRESENT_F (1 << 0)
+#define MMAP_FAULT_WRITE_F (1 << 1)
+
+// Returns the valid page cache page for page `index` of the backing object.
+typedef page_cache_page *(*mmap_get_page_fn)(void *ctx, uint32_t index);
+// Drops the region's reference on the backing object.
+typedef void (*mmap_release_fn)(void *ctx);
+
+// A read-only linear range whose pages are filled on demand, through the
+// page cache, from page `first_index` onwards of page cache inode `inode`.
+typedef struct mmap_region {
+    uint8_t used;
+    uint32_t start;
+    uint32_t size;
+    uint32_t inode;
+    uint32_t first_index;
+    uint32_t pages;
+    mmap_get_page_fn get_page;
+    mmap_release_fn release;
+    void *ctx;
+} mmap_region;
+
+// Reserve a linear range of `pages` pages backed by the given object.
+//
+// No page is read until it is first touched, returns the start of the range
+// or 0 if the window is exhausted.
+void *mmap_create(uint32_t inode, uint32_t first_index, uint32_t pages,
+                  mmap_get_page_fn get_page, mmap_release_fn release,
+                  void *ctx);
+
+// Map `size` bytes of a raw block device starting at `lba`, which must be
+// page aligned (a multiple of 8 sectors).
+void *mmap_device(blk_device *dev, uint32_t lba, uint32_t size);
+
+// Unmap the region starting at `addr` and release its backing object.
+int mmap_destroy(void *addr);
+
+// Page fault path, returns 1 if `addr` lies in a region and the page was
+// mapped, 0 if the fault is not for an mmap region or cannot be satisfied.
+int mmap_fault(uint32_t addr, uint32_t error);
+
+// Test and clear the accessed bit of every mapping of `page`, returns 1 if
+// any mapping was accessed since the last call.
+int mmap_page_referenced(page_cache_page *page);
+
+// Remove every mapping of `page` so it can be evicted, the next access faults
+// it back in.
+void mmap_page_unmap(page_cache_page *page);
+
+#endif  // MMAP_H
@@ -2,7 +2,16 @@
 
 #include <stdbool.h>
 
+#include "../cpu/cpu.h"
 #include "heap.h"
+#include "memory.h"
+
+// Kernel half template copied into every directory from
+// paging_create_directory, its page tables are shared by all of them.
+page_directory_entry *paging_kernel_directory = 0;
+
+// Next free address of the MMIO window.
+uint32_t paging_mmio_next = PAGING_MMIO_BASE;
 
 int8_t paging_remap(page_directory_entry *table, uint32_t linear_addr,
                     uint32_t physical_addr, uint32_t size, uint32_t flags,
@@ -39,10 +48,13 @@ int8_t paging_remap(page_directory_entry *table, uint32_t linear_addr,
             if (!page_table) {
                 return 0;
             }
-            dte->s.frame = ((uint32_t)page_table) >> PAGE_SIZE_SHIFT;
-            dte->i |= flags;
+            dte->s.frame = MEMORY_PHYS(page_table) >> PAGE_SIZE_SHIFT;
+            // page table entries decide on write access, a read-only
+            // directory entry would apply to all 4MiB it covers.
+            dte->i |= (flags & (PAGING_PRESENT_F | PAGING_USER_F)) |
+                      PAGING_RW_F;
         } else {
-            page_table = (page_table_entry *)(dte->s.frame << PAGE_SIZE_SHIFT);
+            page_table = MEMORY_VIRT(dte->s.frame << PAGE_SIZE_SHIFT);
         }
 
     skip_lookup:
@@ -57,35 +69,155 @@ int8_t paging_remap(page_directory_entry *table, uint32_t linear_addr,
     return 1;
 }
 
-page_directory_entry *paging_identity_map(uint32_t size, uint32_t flags) {
+// Free the page tables of directory entries [first, last) and the directory.
+void paging_free_directory(page_directory_entry *table, uint32_t first,
+                           uint32_t last) {
+    for (uint32_t i = first; i < last; i++) {
+        if (!table[i].s.present) {
+            continue;
+        }
+        heap_free(MEMORY_VIRT(table[i].s.frame << PAGE_SIZE_SHIFT));
+    }
+    heap_free(table);
+}
+
+page_directory_entry *paging_kernel_map(uint32_t size, uint32_t flags) {
+    if (size > PAGING_KERNEL_MAP_MAX) {
+        return 0;
+    }
+
     page_directory_entry *page_directory = heap_zalloc(PAGE_SIZE);
     if (!page_directory) {
         return 0;
     }
 
-    if (!paging_remap(page_directory, 0, 0, size, flags, false)) {
-        for (uint32_t i = 0; i < PAGING_PD_SIZE; i++) {
-            if (!page_directory[i].s.present) {
-                continue;
-            }
-            heap_free((void *)(page_directory[i].s.frame << PAGE_SIZE_SHIFT));
+    // every kernel half page table exists up front, so mappings added later
+    // show up in all address spaces without touching their directories.
+    for (uint32_t i = PAGING_KERNEL_PDE; i < PAGING_PD_SIZE; i++) {
+        page_table_entry *page_table = heap_zalloc(PAGE_SIZE);
+        if (!page_table) {
+            paging_free_directory(page_directory, PAGING_KERNEL_PDE,
+                                  PAGING_PD_SIZE);
+            return 0;
         }
-        heap_free(page_directory);
+        page_directory[i].i = MEMORY_PHYS(page_table) | PAGING_PRESENT_F |
+                              PAGING_RW_F;
+    }
+
+    if (!paging_remap(page_directory, MEMORY_KERNEL_BASE, 0, size,
+                      flags | PAGING_GLOBAL_F, false)) {
+        paging_free_directory(page_directory, PAGING_KERNEL_PDE,
+                              PAGING_PD_SIZE);
         return 0;
     }
 
+    paging_kernel_directory = page_directory;
+    return page_directory;
+}
+
+page_directory_entry *paging_create_directory() {
+    if (!paging_kernel_directory) {
+        return 0;
+    }
+    page_directory_entry *page_directory = heap_zalloc(PAGE_SIZE);
+    if (!page_directory) {
+        return 0;
+    }
+    for (uint32_t i = PAGING_KERNEL_PDE; i < PAGING_PD_SIZE; i++) {
+        page_directory[i] = paging_kernel_directory[i];
+    }
     return page_directory;
 }
 
+void paging_destroy_directory(page_directory_entry *table) {
+    if (!table || table == paging_kernel_directory) {
+        return;
+    }
+    paging_free_directory(table, 0, PAGING_KERNEL_PDE);
+}
+
+void *paging_map_mmio(uint32_t physical_addr, uint32_t size) {
+    uint32_t base = physical_addr & ~PAGE_ALIGN_MASK;
+    size = (physical_addr - base + size + PAGE_ALIGN_MASK) & ~PAGE_ALIGN_MASK;
+    if (!size || !paging_kernel_directory ||
+        size > PAGING_MMIO_END - paging_mmio_next) {
+        return 0;
+    }
+
+    // the window is never reused, so there is no stale TLB entry to flush.
+    if (!paging_remap(paging_kernel_directory, paging_mmio_next, base, size,
+                      PAGING_PRESENT_F | PAGING_RW_F | PAGING_CACHE_DISABLE_F |
+                          PAGING_GLOBAL_F,
+                      false)) {
+        return 0;
+    }
+    uint32_t linear = paging_mmio_next + (physical_addr - base);
+    paging_mmio_next += size;
+    return (void *)linear;
+}
+
 int paging_set_directory_table(page_directory_entry *table) {
-    asm volatile("mov %0, %%cr3" : : "r"((uint32_t)table) : "memory");
+    asm volatile("mov %0, %%cr3" : : "r"(MEMORY_PHYS(table)) : "memory");
     return 0;
 }
 
+page_directory_entry *paging_get_directory_table() {
+    uint32_t table;
+    asm volatile("mov %%cr3, %0" : "=r"(table));
+    return MEMORY_VIRT(table);
+}
+
+page_table_entry *paging_get_entry(page_directory_entry *table,
+                                   uint32_t linear_addr) {
+    uint32_t frame = PAGING_FRAME(linear_addr);
+    page_directory_entry *dte = &table[PAGING_DTE_INDEX(frame)];
+    if (!dte->s.present) {
+        return 0;
+    }
+    page_table_entry *page_table = MEMORY_VIRT(dte->s.frame << PAGE_SIZE_SHIFT);
+    return &page_table[PAGING_PT_INDEX(frame)];
+}
+
+int8_t paging_unmap(page_directory_entry *table, uint32_t linear_addr,
+                    uint32_t size) {
+    if (!table || (linear_addr & PAGE_ALIGN_MASK) != 0 ||
+        (size & PAGE_ALIGN_MASK) != 0) {
+        return 0;
+    }
+
+    for (uint32_t addr = linear_addr; addr < linear_addr + size;
+         addr += PAGE_SIZE) {
+        page_table_entry *pte = paging_get_entry(table, addr);
+        if (!pte || !pte->s.present) {
+            continue;
+        }
+        pte->i = 0;
+        paging_invalidate_page(addr);
+    }
+
+    return 1;
+}
+
+void paging_invalidate_page(uint32_t linear_addr) {
+    asm volatile("invlpg (%0)" : : "r"(linear_addr) : "memory");
+}
+
 int paging_enable() {
+    cpu_cpuid_regs regs;
+    cpu_cpuid(CPU_CPUID_FEATURES, &regs);
+    if (regs.edx & CPU_CPUID_EDX_PGE) {
+        asm volatile(
+            "mov %%cr4, %%eax\n\t"
+            "or %0, %%eax\n\t"
+            "mov %%eax, %%cr4"
+            :
+            : "i"(PAGING_CR4_PGE)
+            : "eax", "memory");
+    }
+
     asm volatile(
         "mov %%cr0, %%eax\n\t"
-        "or $0x80000000, %%eax\n\t"
+        "or $0x80010000, %%eax\n\t"
         "mov %%eax, %%cr0"
         :
         :
@@ -1,6 +1,11 @@
+#ifndef PAGING_H
+#define PAGING_H
+
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "memory.h"
+
 #define PAGE_SIZE_SHIFT 12
 #define PAGE_SIZE (1 << PAGE_SIZE_SHIFT)  // 4096
 #define PAGE_ALIGN_MASK (PAGE_SIZE - 1)   // 0xFFF
@@ -23,6 +28,20 @@
 #define PAGING_PAGE_SIZE_F (1 << 7)
 #define PAGING_GLOBAL_F (1 << 8)
 
+#define PAGING_CR4_PGE (1 << 7)
+
+// First directory entry of the kernel half, MEMORY_KERNEL_BASE and up.
+#define PAGING_KERNEL_PDE (MEMORY_KERNEL_BASE >> 22)  // 768
+// The kernel's direct map of physical memory ends where the mmap window
+// begins.
+#define PAGING_KERNEL_MAP_MAX (PAGING_MMAP_BASE - MEMORY_KERNEL_BASE)
+// Kernel half window for mmap regions, see mmap.h.
+#define PAGING_MMAP_BASE 0xE0000000
+#define PAGING_MMAP_END PAGING_MMIO_BASE
+// Kernel half window for device registers mapped with paging_map_mmio.
+#define PAGING_MMIO_BASE 0xF0000000
+#define PAGING_MMIO_END 0xFFFFF000  // the top page stays unmapped
+
 typedef union {
     uint32_t i;
     struct {
@@ -56,12 +75,26 @@ typedef union {
     } s;
 } page_table_entry;
 
-// create a 1:1 identity mapping and returns a pointer to the start of a
-// page directory.
+// create the kernel's page directory and return a pointer to it.
 //
-// the identity mapping is created from base address 0x0 to size, where size
-// must be a multiple of PAGE_SIZE (4096 by default).
-page_directory_entry *paging_identity_map(uint32_t size, uint32_t flags);
+// physical memory from 0x0 to size is mapped at MEMORY_KERNEL_BASE, where size
+// must be a multiple of PAGE_SIZE (4096 by default). Kernel half mappings are
+// global: with CR4.PGE on their TLB entries survive CR3 reloads, so changing
+// an existing kernel mapping needs paging_invalidate_page. The low half is
+// left empty, boot's identity map is gone once this directory is loaded.
+page_directory_entry *paging_kernel_map(uint32_t size, uint32_t flags);
+
+// create a page directory for a new address space, its low half is empty
+// and its kernel half shares the page tables of the kernel's directory.
+page_directory_entry *paging_create_directory();
+
+// free a directory from paging_create_directory with its low half page
+// tables, the pages they map are left to their owner.
+void paging_destroy_directory(page_directory_entry *table);
+
+// map `size` bytes of device registers at `physical_addr` uncached in the
+// kernel half and return their address, or 0 once the window is exhausted.
+void *paging_map_mmio(uint32_t physical_addr, uint32_t size);
 
 // (re)map the linear address space of `size` to the physical address space.
 //
@@ -74,5 +107,26 @@ int8_t paging_remap(page_directory_entry *table, uint32_t linear_addr,
 // set the cr3 register to point to the given page directory table.
 int paging_set_directory_table(page_directory_entry *table);
 
+// return the page directory table currently loaded in the cr3 register.
+page_directory_entry *paging_get_directory_table();
+
+// return the page table entry mapping `linear_addr`, or 0 if no page table
+// covers the address.
+page_table_entry *paging_get_entry(page_directory_entry *table,
+                                   uint32_t linear_addr);
+
+// clear the mappings of the linear address space of `size` and invalidate
+// their TLB entries, page tables are kept.
+int8_t paging_unmap(page_directory_entry *table, uint32_t linear_addr,
+                    uint32_t size);
+
+// invalidate the TLB entry for the page containing `linear_addr`.
+void paging_invalidate_page(uint32_t linear_addr);
+
 // enable paging by setting the relevant bit in cr0 register.
+//
+// write protection is enabled as well, so read-only mappings are honored
+// in ring 0, and so are global pages when the CPU supports them.
 int paging_enable();
+
+#endif  // PAGING_H
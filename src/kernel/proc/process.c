@@ -0,0 +1,171 @@
+#include "process.h"
+
+#include <stdint.h>
+
+#include "../gdt.h"
+#include "../memory/heap.h"
+#include "../memory/memory.h"
+#include "../syscall/syscall.h"
+
+#define PROCESS_STR(x) #x
+#define PROCESS_XSTR(x) PROCESS_STR(x)
+
+process *process_running = 0;
+uint32_t process_next_pid = 1;
+
+// Save the callee saved registers and EFLAGS, store the kernel ESP in
+// `*saved_esp` and iret to ring 3 at `eip` with the stack at `esp`. Returns
+// the exit code passed to process_leave.
+__attribute__((naked)) int32_t process_enter(uint32_t eip, uint32_t esp,
+                                             uint32_t *saved_esp) {
+    asm volatile(
+        "push %ebp\n\t"
+        "push %ebx\n\t"
+        "push %esi\n\t"
+        "push %edi\n\t"
+        "pushf\n\t"
+        // arguments start above the five saves and the return address.
+        "mov 32(%esp), %eax\n\t"
+        "mov %esp, (%eax)\n\t"
+        "mov 24(%esp), %ecx\n\t"
+        "mov 28(%esp), %edx\n\t"
+        "push $" PROCESS_XSTR(GDT_USER_DATA) "\n\t"
+        "push %edx\n\t"
+        "push $" PROCESS_XSTR(PROCESS_EFLAGS) "\n\t"
+        "push $" PROCESS_XSTR(GDT_USER_CODE) "\n\t"
+        "push %ecx\n\t"
+        "mov $" PROCESS_XSTR(GDT_USER_DATA) ", %eax\n\t"
+        "mov %ax, %ds\n\t"
+        "mov %ax, %es\n\t"
+        "mov %ax, %fs\n\t"
+        "mov %ax, %gs\n\t"
+        // leave no kernel values behind in the user's registers.
+        "xor %eax, %eax\n\t"
+        "xor %ebx, %ebx\n\t"
+        "xor %ecx, %ecx\n\t"
+        "xor %edx, %edx\n\t"
+        "xor %esi, %esi\n\t"
+        "xor %edi, %edi\n\t"
+        "xor %ebp, %ebp\n\t"
+        "iret");
+}
+
+// Switch back to the kernel stack saved by process_enter and return from it
+// with `code`, abandoning whatever runs on the process' kernel stack.
+__attribute__((naked)) void process_leave(uint32_t saved_esp, int32_t code) {
+    asm volatile(
+        "mov 8(%esp), %eax\n\t"
+        "mov 4(%esp), %esp\n\t"
+        "mov $" PROCESS_XSTR(GDT_KERNEL_DATA) ", %ecx\n\t"
+        "mov %cx, %ds\n\t"
+        "mov %cx, %es\n\t"
+        "mov %cx, %fs\n\t"
+        "mov %cx, %gs\n\t"
+        "popf\n\t"
+        "pop %edi\n\t"
+        "pop %esi\n\t"
+        "pop %ebx\n\t"
+        "pop %ebp\n\t"
+        "ret");
+}
+
+process *process_create(const void *image, uint32_t size) {
+    if (!size || size > PROCESS_MAX_IMAGE_SIZE) {
+        return 0;
+    }
+    process *p = heap_zalloc(sizeof(process));
+    if (!p) {
+        return 0;
+    }
+
+    p->image_size = (size + PAGE_ALIGN_MASK) & ~PAGE_ALIGN_MASK;
+    p->directory = paging_create_directory();
+    p->image = heap_zalloc(p->image_size);
+    p->stack = heap_zalloc(PROCESS_STACK_SIZE);
+    p->kernel_stack = heap_malloc(PROCESS_KERNEL_STACK_SIZE);
+    if (!p->directory || !p->image || !p->stack || !p->kernel_stack) {
+        process_destroy(p);
+        return 0;
+    }
+    memcpy(p->image, image, size);
+
+    const uint32_t user = PAGING_PRESENT_F | PAGING_USER_F;
+    if (!paging_remap(p->directory, PROCESS_IMAGE_BASE, MEMORY_PHYS(p->image),
+                      p->image_size, user | PAGING_RW_F, false) ||
+        !paging_remap(p->directory, PROCESS_STACK_TOP - PROCESS_STACK_SIZE,
+                      MEMORY_PHYS(p->stack), PROCESS_STACK_SIZE,
+                      user | PAGING_RW_F, false) ||
+        !paging_remap(p->directory, SYSCALL_VSYSCALL_BASE,
+                      MEMORY_PHYS(syscall_vsyscall_page()), PAGE_SIZE, user,
+                      false)) {
+        process_destroy(p);
+        return 0;
+    }
+
+    fpu_state_init(&p->fpu);
+    p->pid = process_next_pid++;
+    return p;
+}
+
+void process_destroy(process *p) {
+    if (!p || p == process_running) {
+        return;
+    }
+    // the registers may still hold the process' FPU state, a later save
+    // would write it into freed memory.
+    fpu_release(&p->fpu);
+    paging_destroy_directory(p->directory);
+    heap_free(p->image);
+    heap_free(p->stack);
+    heap_free(p->kernel_stack);
+    heap_free(p);
+}
+
+int32_t process_run(process *p) {
+    if (!p || process_running) {
+        return PROCESS_EXIT_FAULT;
+    }
+
+    uint32_t kernel_stack_top =
+        (uint32_t)p->kernel_stack + PROCESS_KERNEL_STACK_SIZE;
+    gdt_set_kernel_stack(kernel_stack_top);
+    syscall_set_kernel_stack(kernel_stack_top);
+
+    page_directory_entry *directory = paging_get_directory_table();
+    paging_set_directory_table(p->directory);
+    fpu_switch(&p->fpu);
+    process_running = p;
+
+    int32_t code =
+        process_enter(PROCESS_IMAGE_BASE, PROCESS_STACK_TOP, &p->kernel_esp);
+
+    process_running = 0;
+    fpu_switch(0);
+    paging_set_directory_table(directory);
+    return code;
+}
+
+process *process_current() { return process_running; }
+
+void process_exit(int32_t code) {
+    if (!process_running) {
+        return;
+    }
+    process_leave(process_running->kernel_esp, code);
+}
+
+int process_user_readable(uint32_t addr, uint32_t size) {
+    if (!process_running || addr + size < addr ||
+        addr + size > MEMORY_KERNEL_BASE) {
+        return 0;
+    }
+    for (uint32_t page = addr & ~PAGE_ALIGN_MASK; page < addr + size;
+         page += PAGE_SIZE) {
+        page_table_entry *pte =
+            paging_get_entry(process_running->directory, page);
+        if (!pte || !pte->s.present || !pte->s.user) {
+            return 0;
+        }
+    }
+    return 1;
+}
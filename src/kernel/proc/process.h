@@ -0,0 +1,62 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <stdint.h>
+
+#include "../cpu/fpu.h"
+#include "../memory/paging.h"
+
+// User address space layout, everything below MEMORY_KERNEL_BASE.
+//
+// The image is loaded at PROCESS_IMAGE_BASE and entered at its first byte,
+// the stack grows down from PROCESS_STACK_TOP and the read-only vsyscall page
+// sits at the top, see syscall.h.
+#define PROCESS_IMAGE_BASE 0x00400000
+#define PROCESS_MAX_IMAGE_SIZE (1 << 20)
+#define PROCESS_STACK_TOP 0xBFFF0000
+#define PROCESS_STACK_SIZE (16 * 1024)
+// Kernel stack used for system calls and interrupts taken in ring 3.
+#define PROCESS_KERNEL_STACK_SIZE (16 * 1024)
+
+// User EFLAGS on entry, interrupts enabled.
+#define PROCESS_EFLAGS 0x202
+
+// Exit code of a process killed by a fault.
+#define PROCESS_EXIT_FAULT -1
+
+typedef struct process {
+    fpu_state fpu;
+    uint32_t pid;
+    page_directory_entry *directory;
+    uint8_t *image;
+    uint32_t image_size;
+    uint8_t *stack;
+    uint8_t *kernel_stack;
+    // kernel ESP saved by process_run, process_exit returns there.
+    uint32_t kernel_esp;
+} process;
+
+// Create a process running a copy of the flat binary `image` in its own
+// address space. The image must be position independent or linked at
+// PROCESS_IMAGE_BASE. Returns 0 on failure.
+process *process_create(const void *image, uint32_t size);
+
+// Free a process which is not running, with its address space.
+void process_destroy(process *p);
+
+// Run `p` in ring 3 until it exits, returning its exit code. Only one
+// process runs at a time, the caller's address space and FPU state are back
+// in place on return.
+int32_t process_run(process *p);
+
+// The running process, 0 outside process_run.
+process *process_current();
+
+// Terminate the running process, process_run returns `code`. Called from
+// system calls and from exception handlers for faults taken in ring 3.
+void process_exit(int32_t code);
+
+// Return 1 if the running process may read `size` bytes at `addr`.
+int process_user_readable(uint32_t addr, uint32_t size);
+
+#endif  // PROCESS_H
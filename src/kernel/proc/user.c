@@ -0,0 +1,29 @@
+#include "user.h"
+
+#include "../syscall/syscall.h"
+
+#define USER_STR(x) #x
+#define USER_XSTR(x) USER_STR(x)
+
+asm(".section .rodata\n"
+    ".global user_hello_start\n"
+    ".global user_hello_end\n"
+    "user_hello_start:\n\t"
+    "call 1f\n"
+    "1:\n\t"
+    "pop %ebx\n\t"
+    "add $(user_hello_message - 1b), %ebx\n\t"
+    "mov $(user_hello_message_end - user_hello_message), %esi\n\t"
+    "mov $" USER_XSTR(SYSCALL_WRITE) ", %eax\n\t"
+    "mov $" USER_XSTR(SYSCALL_VSYSCALL_BASE) ", %edi\n\t"
+    "call *%edi\n\t"
+    "mov $" USER_XSTR(SYSCALL_GETPID) ", %eax\n\t"
+    "call *%edi\n\t"
+    "mov %eax, %ebx\n\t"
+    "mov $" USER_XSTR(SYSCALL_EXIT) ", %eax\n\t"
+    "call *%edi\n"
+    "user_hello_message:\n\t"
+    ".ascii \"Hello from ring 3\\n\"\n"
+    "user_hello_message_end:\n"
+    "user_hello_end:\n"
+    ".previous");
@@ -0,0 +1,12 @@
+#ifndef USER_H
+#define USER_H
+
+#include <stdint.h>
+
+// Built-in user programs, position independent flat binaries for
+// process_create.
+
+// Writes a greeting through the write system call and exits with its pid.
+extern const uint8_t user_hello_start[], user_hello_end[];
+
+#endif  // USER_H
@@ -0,0 +1,103 @@
+#include "profiler.h"
+
+#include <stdint.h>
+
+#include "../drivers/serial/serial.h"
+#include "../memory/heap.h"
+#include "../timer/timer.h"
+
+profiler_sample *profiler_samples;
+volatile uint32_t profiler_count;
+volatile uint32_t profiler_dropped;
+volatile uint8_t profiler_running;
+uint32_t profiler_hz;
+
+// Timer callback, records the interrupted EIP and walks the saved EBP chain.
+//
+// A frame is trusted only if it lies above the interrupt frame, below the
+// stack top and above the previous frame, so a sample taken while EBP holds
+// something else ends the walk early rather than faulting.
+void profiler_tick(uint32_t *stack) {
+    if (!profiler_running) {
+        return;
+    }
+    if (profiler_count >= PROFILER_MAX_SAMPLES) {
+        profiler_dropped++;
+        return;
+    }
+
+    profiler_sample *s = &profiler_samples[profiler_count];
+    // EBP and EIP in the idt_handler frame, see idt_div_by_zero.
+    uint32_t fp = *(stack + 2);
+    s->pcs[0] = *(stack + 8);
+    s->depth = 1;
+
+    uint32_t low = (uint32_t)stack;
+    while (s->depth < PROFILER_MAX_FRAMES && fp > low && !(fp & 3) &&
+           fp + 8 <= PROFILER_STACK_TOP) {
+        uint32_t *frame = (uint32_t *)fp;
+        if (!frame[1]) {
+            break;
+        }
+        s->pcs[s->depth++] = frame[1];
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+
+    profiler_count++;
+}
+
+int profiler_init() {
+    profiler_samples =
+        heap_malloc(PROFILER_MAX_SAMPLES * sizeof(profiler_sample));
+    if (!profiler_samples) {
+        return 0;
+    }
+    profiler_reset();
+    return 1;
+}
+
+void profiler_start(uint32_t hz) {
+    if (!profiler_samples) {
+        return;
+    }
+    profiler_hz = hz;
+    profiler_running = 1;
+    timer_set_tick(hz, profiler_tick);
+}
+
+void profiler_stop() {
+    profiler_running = 0;
+    timer_set_tick(0, 0);
+}
+
+void profiler_reset() {
+    profiler_count = 0;
+    profiler_dropped = 0;
+}
+
+void profiler_dump() {
+    uint32_t count = profiler_count;
+
+    serial_write_str("profile: begin hz=");
+    serial_write_dec(profiler_hz);
+    serial_write_str(" samples=");
+    serial_write_dec(count);
+    serial_write_str(" dropped=");
+    serial_write_dec(profiler_dropped);
+    serial_write_str("\n");
+
+    for (uint32_t i = 0; i < count; i++) {
+        profiler_sample *s = &profiler_samples[i];
+        serial_write_str("s");
+        for (uint32_t j = 0; j < s->depth; j++) {
+            serial_write_str(" ");
+            serial_write_hex(s->pcs[j]);
+        }
+        serial_write_str("\n");
+    }
+
+    serial_write_str("profile: end\n");
+}
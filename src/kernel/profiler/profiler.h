@@ -0,0 +1,46 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+#include "../memory/memory.h"
+
+// Samples kept until the next profiler_reset, later samples are dropped.
+#define PROFILER_MAX_SAMPLES 8192
+// Program counters recorded per sample, the interrupted EIP followed by the
+// return addresses found walking the frame pointer chain.
+#define PROFILER_MAX_FRAMES 16
+#define PROFILER_DEFAULT_HZ 1000
+// Top of the boot stack set up in kernel.asm, frame walks never go past it.
+#define PROFILER_STACK_TOP (MEMORY_KERNEL_BASE + 0x300000)
+
+typedef struct profiler_sample {
+    uint32_t depth;
+    uint32_t pcs[PROFILER_MAX_FRAMES];
+} profiler_sample;
+
+// Allocate the sample buffer.
+int profiler_init();
+
+// Start sampling `hz` times per second, the PIT ticks periodically rather
+// than for timer deadlines only while sampling. timer_init must have run.
+void profiler_start(uint32_t hz);
+
+// Stop sampling and return the PIT to one-shot mode, the samples are kept for
+// profiler_dump.
+void profiler_stop();
+
+// Discard every sample.
+void profiler_reset();
+
+// Stream the samples over serial, one line per sample:
+//
+//   profile: begin hz=<hz> samples=<n> dropped=<n>
+//   s <eip> <return address> ...
+//   profile: end
+//
+// addresses are in hex, scripts/profile.py symbolizes them against
+// src/kernel/kernel.
+void profiler_dump();
+
+#endif  // PROFILER_H
@@ -0,0 +1,177 @@
+#include "syscall.h"
+
+#include <stdint.h>
+
+#include "../cpu/cpu.h"
+#include "../drivers/serial/serial.h"
+#include "../drivers/vga/vga.h"
+#include "../gdt.h"
+#include "../idt.h"
+#include "../memory/heap.h"
+#include "../memory/memory.h"
+#include "../proc/process.h"
+
+#define SYSCALL_STR(x) #x
+#define SYSCALL_XSTR(x) SYSCALL_STR(x)
+
+// vsyscall entries, copied into the vsyscall page so they must be position
+// independent. SYSEXIT resumes at EDX with ESP from ECX, which the SYSENTER
+// entry points at its own `ret`.
+asm(".section .rodata\n"
+    "syscall_stub_int80:\n\t"
+    "int $" SYSCALL_XSTR(SYSCALL_INT_VECTOR) "\n\t"
+    "ret\n"
+    "syscall_stub_int80_end:\n"
+    "syscall_stub_sysenter:\n\t"
+    "call 1f\n"
+    "1:\n\t"
+    "pop %edx\n\t"
+    "add $(2f - 1b), %edx\n\t"
+    "mov %esp, %ecx\n\t"
+    "sysenter\n"
+    "2:\n\t"
+    "ret\n"
+    "syscall_stub_sysenter_end:\n"
+    ".previous");
+extern const uint8_t syscall_stub_int80[], syscall_stub_int80_end[];
+extern const uint8_t syscall_stub_sysenter[], syscall_stub_sysenter_end[];
+
+uint8_t *syscall_vsyscall;
+int syscall_sysenter;
+
+int32_t syscall_exit(uint32_t code, uint32_t b, uint32_t c) {
+    process_exit(code);
+    return 0;
+}
+
+int32_t syscall_getpid(uint32_t a, uint32_t b, uint32_t c) {
+    return process_current()->pid;
+}
+
+int32_t syscall_write(uint32_t buffer, uint32_t size, uint32_t c) {
+    if (!process_user_readable(buffer, size)) {
+        return SYSCALL_EFAULT;
+    }
+    const char *s = (const char *)buffer;
+    for (uint32_t i = 0; i < size; i++) {
+        serial_write_char(s[i]);
+        vga_write_char(&(vga_txt_char){
+            .code = s[i], .bg = VGA_DEFAULT_BG, .fg = 0xF});
+    }
+    return size;
+}
+
+syscall_entry syscall_table[SYSCALL_COUNT] = {
+    [SYSCALL_EXIT] = {"exit", syscall_exit},
+    [SYSCALL_GETPID] = {"getpid", syscall_getpid},
+    [SYSCALL_WRITE] = {"write", syscall_write},
+};
+
+int32_t syscall_dispatch(uint32_t n, uint32_t a, uint32_t b, uint32_t c,
+                         uint32_t path) {
+    if (n >= SYSCALL_COUNT) {
+        return SYSCALL_ENOSYS;
+    }
+    syscall_table[n].calls[path]++;
+    return syscall_table[n].fn(a, b, c);
+}
+
+// SYSENTER lands here on the process' kernel stack with interrupts disabled,
+// ECX and EDX holding the user ESP and resume address. The callee saved
+// registers survive syscall_dispatch, so only ECX and EDX need restoring.
+__attribute__((naked)) void syscall_sysenter_entry() {
+    asm volatile(
+        "cld\n\t"
+        "push %ecx\n\t"
+        "push %edx\n\t"
+        "push $" SYSCALL_XSTR(SYSCALL_PATH_SYSENTER) "\n\t"
+        "push %edi\n\t"
+        "push %esi\n\t"
+        "push %ebx\n\t"
+        "push %eax\n\t"
+        "call syscall_dispatch\n\t"
+        "add $20, %esp\n\t"
+        "pop %edx\n\t"
+        "pop %ecx\n\t"
+        // SYSEXIT keeps EFLAGS, the user runs with interrupts enabled.
+        "sti\n\t"
+        "sysexit");
+}
+
+// EAX, EBX, ESI and EDI in the pusha frame, see idt_div_by_zero.
+void syscall_int80(uint32_t *stack) {
+    asm volatile("cld");
+    *(stack + 7) = syscall_dispatch(*(stack + 7), *(stack + 4), *(stack + 1),
+                                    *(stack + 0), SYSCALL_PATH_INT80);
+}
+idt_handler(syscall_handler_int80, syscall_int80);
+
+// CPUID reports SEP on early Pentium Pro parts which lack SYSENTER.
+int syscall_detect_sysenter() {
+    cpu_cpuid_regs regs;
+    cpu_cpuid(CPU_CPUID_FEATURES, &regs);
+    if (!(regs.edx & CPU_CPUID_EDX_SEP)) {
+        return 0;
+    }
+    uint32_t family = (regs.eax >> 8) & 0xF;
+    uint32_t model = (regs.eax >> 4) & 0xF;
+    uint32_t stepping = regs.eax & 0xF;
+    return !(family == 6 && model < 3 && stepping < 3);
+}
+
+int syscall_init() {
+    syscall_vsyscall = heap_zalloc(PAGE_SIZE);
+    if (!syscall_vsyscall) {
+        return 0;
+    }
+    syscall_sysenter = syscall_detect_sysenter();
+
+    uint32_t int80_size = syscall_stub_int80_end - syscall_stub_int80;
+    uint32_t sysenter_size = syscall_stub_sysenter_end - syscall_stub_sysenter;
+    memcpy(syscall_vsyscall + SYSCALL_VSYSCALL_INT80, syscall_stub_int80,
+           int80_size);
+    memcpy(syscall_vsyscall + SYSCALL_VSYSCALL_SYSENTER,
+           syscall_stub_sysenter, sysenter_size);
+    if (syscall_sysenter) {
+        memcpy(syscall_vsyscall + SYSCALL_VSYSCALL_DEFAULT,
+               syscall_stub_sysenter, sysenter_size);
+        cpu_write_msr(SYSCALL_MSR_SYSENTER_CS, GDT_KERNEL_CODE);
+        cpu_write_msr(SYSCALL_MSR_SYSENTER_EIP,
+                      (uint32_t)syscall_sysenter_entry);
+    } else {
+        memcpy(syscall_vsyscall + SYSCALL_VSYSCALL_DEFAULT, syscall_stub_int80,
+               int80_size);
+    }
+
+    idt_set_user(SYSCALL_INT_VECTOR, syscall_handler_int80);
+    return 1;
+}
+
+int syscall_sysenter_supported() { return syscall_sysenter; }
+
+void *syscall_vsyscall_page() { return syscall_vsyscall; }
+
+void syscall_set_kernel_stack(uint32_t esp) {
+    if (syscall_sysenter) {
+        cpu_write_msr(SYSCALL_MSR_SYSENTER_ESP, esp);
+    }
+}
+
+uint32_t syscall_calls(uint32_t n, uint32_t path) {
+    if (n >= SYSCALL_COUNT || path >= SYSCALL_PATHS) {
+        return 0;
+    }
+    return syscall_table[n].calls[path];
+}
+
+void syscall_dump() {
+    for (uint32_t i = 0; i < SYSCALL_COUNT; i++) {
+        serial_write_str("syscall: name=");
+        serial_write_str(syscall_table[i].name);
+        serial_write_str(" sysenter=");
+        serial_write_dec(syscall_table[i].calls[SYSCALL_PATH_SYSENTER]);
+        serial_write_str(" int80=");
+        serial_write_dec(syscall_table[i].calls[SYSCALL_PATH_INT80]);
+        serial_write_str("\n");
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#include <stdint.h>
+
+// System call ABI: the number in EAX, arguments in EBX, ESI and EDI, the
+// result in EAX. ECX and EDX are clobbered, every other register is kept.
+//
+// User code calls SYSCALL_VSYSCALL_BASE, the entry of the vsyscall page,
+// which enters the kernel through SYSENTER when the CPU supports it and
+// through int 0x80 otherwise.
+#define SYSCALL_INT_VECTOR 0x80
+
+#define SYSCALL_MSR_SYSENTER_CS 0x174
+#define SYSCALL_MSR_SYSENTER_ESP 0x175
+#define SYSCALL_MSR_SYSENTER_EIP 0x176
+
+// Read-only page mapped at the top of every user address space. Besides the
+// default entry it holds one entry per mechanism, for benchmarks.
+#define SYSCALL_VSYSCALL_BASE 0xBFFFF000
+#define SYSCALL_VSYSCALL_DEFAULT 0x00
+#define SYSCALL_VSYSCALL_INT80 0x40
+#define SYSCALL_VSYSCALL_SYSENTER 0x80
+#define SYSCALL_VSYSCALL_ENTRY_SIZE 0x40
+
+#define SYSCALL_EXIT 0     // exit(code), does not return
+#define SYSCALL_GETPID 1   // getpid()
+#define SYSCALL_WRITE 2    // write(buffer, size), to the console
+#define SYSCALL_COUNT 3
+
+#define SYSCALL_ENOSYS -1
+#define SYSCALL_EFAULT -2
+
+// Entry mechanism, counted separately for every system call.
+#define SYSCALL_PATH_INT80 0
+#define SYSCALL_PATH_SYSENTER 1
+#define SYSCALL_PATHS 2
+
+typedef int32_t (*syscall_fn)(uint32_t a, uint32_t b, uint32_t c);
+
+typedef struct syscall_entry {
+    const char *name;
+    syscall_fn fn;
+    uint32_t calls[SYSCALL_PATHS];
+} syscall_entry;
+
+// Build the vsyscall page, program the SYSENTER MSRs when the CPU supports
+// SYSENTER and install the int 0x80 gate, the only one user code may raise.
+int syscall_init();
+
+// Return 1 if SYSENTER/SYSEXIT are available and in use.
+int syscall_sysenter_supported();
+
+// The vsyscall page, for mapping into user address spaces.
+void *syscall_vsyscall_page();
+
+// Set the kernel stack SYSENTER switches to, the top of the running
+// process' kernel stack.
+void syscall_set_kernel_stack(uint32_t esp);
+
+// Count and run system call `n`, called by both entry paths.
+int32_t syscall_dispatch(uint32_t n, uint32_t a, uint32_t b, uint32_t c,
+                         uint32_t path);
+
+// Number of calls to system call `n` through `path`.
+uint32_t syscall_calls(uint32_t n, uint32_t path);
+
+// Print the per system call counters over serial, one line per call:
+//
+//   syscall: name=<name> sysenter=<n> int80=<n>
+void syscall_dump();
+
+#endif  // SYSCALL_H
@@ -0,0 +1,169 @@
+#include "timer.h"
+
+#include <stdint.h>
+
+#include "../cpu/cpu.h"
+#include "../idle/idle.h"
+
+uint32_t timer_khz;
+// TSC cycles in TIMER_PIT_MAX_COUNT clocks of the PIT.
+uint64_t timer_max_cycles;
+// Pending timers, earliest deadline first.
+timer *timer_list;
+uint32_t timer_tick_hz;
+pit_callback timer_tick;
+
+// Program the PIT for the earliest deadline, or stop it when there is none.
+// Interrupts must be disabled.
+void timer_program() {
+    if (timer_tick_hz) {
+        return;
+    }
+    if (!timer_list) {
+        pit_stop();
+        return;
+    }
+
+    uint64_t now = cpu_rdtsc();
+    uint64_t delta = timer_list->deadline > now ? timer_list->deadline - now
+                                                : 0;
+    uint32_t count = TIMER_PIT_MAX_COUNT;
+    if (delta < timer_max_cycles) {
+        count = cpu_div64(delta * (PIT_FREQUENCY / 1000), timer_khz);
+    }
+    if (count < TIMER_PIT_MIN_COUNT) {
+        count = TIMER_PIT_MIN_COUNT;
+    }
+    pit_set_oneshot(count);
+}
+
+void timer_irq(uint32_t *stack) {
+    if (timer_tick) {
+        timer_tick(stack);
+    }
+
+    uint64_t now = cpu_rdtsc();
+    while (timer_list && timer_list->deadline <= now) {
+        timer *t = timer_list;
+        timer_list = t->next;
+        t->pending = 0;
+        t->fn(t->ctx);
+    }
+    timer_program();
+}
+
+int timer_init() {
+    timer_list = 0;
+    timer_tick_hz = 0;
+    timer_tick = 0;
+
+    pit_set_frequency(TIMER_CALIBRATE_HZ);
+    uint64_t start = pit_get_ticks();
+    while (pit_get_ticks() == start) {
+    }
+    uint64_t tsc = cpu_rdtsc();
+    start = pit_get_ticks();
+    while (pit_get_ticks() - start < TIMER_CALIBRATE_TICKS) {
+    }
+    timer_khz = cpu_div64(cpu_rdtsc() - tsc,
+                          TIMER_CALIBRATE_TICKS * 1000 / TIMER_CALIBRATE_HZ);
+    if (!timer_khz) {
+        return 0;
+    }
+    timer_max_cycles = cpu_div64((uint64_t)TIMER_PIT_MAX_COUNT * timer_khz,
+                                 PIT_FREQUENCY / 1000);
+
+    uint32_t flags = cpu_irq_save();
+    pit_set_callback(timer_irq);
+    timer_program();
+    cpu_irq_restore(flags);
+    return 1;
+}
+
+uint64_t timer_now() { return cpu_rdtsc(); }
+
+uint32_t timer_tsc_khz() { return timer_khz; }
+
+uint64_t timer_us_to_cycles(uint64_t us) {
+    return cpu_div64(us * timer_khz, 1000);
+}
+
+void timer_unlink(timer *t) {
+    for (timer **p = &timer_list; *p; p = &(*p)->next) {
+        if (*p == t) {
+            *p = t->next;
+            break;
+        }
+    }
+    t->pending = 0;
+}
+
+void timer_add(timer *t, uint64_t deadline, timer_fn fn, void *ctx) {
+    uint32_t flags = cpu_irq_save();
+    if (t->pending) {
+        timer_unlink(t);
+    }
+    t->deadline = deadline;
+    t->fn = fn;
+    t->ctx = ctx;
+    t->pending = 1;
+
+    timer **p = &timer_list;
+    while (*p && (*p)->deadline <= deadline) {
+        p = &(*p)->next;
+    }
+    t->next = *p;
+    *p = t;
+    // only a new earliest deadline moves the interrupt.
+    if (timer_list == t) {
+        timer_program();
+    }
+    cpu_irq_restore(flags);
+}
+
+void timer_cancel(timer *t) {
+    uint32_t flags = cpu_irq_save();
+    if (t->pending) {
+        // an interrupt programmed for it arrives early and re-arms.
+        timer_unlink(t);
+    }
+    cpu_irq_restore(flags);
+}
+
+void timer_sleep_done(void *ctx) { *(volatile int *)ctx = 1; }
+
+void timer_sleep_until(uint64_t deadline) {
+    uint32_t flags = cpu_irq_save();
+    if (!(flags & CPU_EFLAGS_IF)) {
+        // no interrupt may be taken, so none can wake us.
+        while (timer_now() < deadline) {
+        }
+        return;
+    }
+
+    volatile int done = 0;
+    timer t = {0};
+    timer_add(&t, deadline, timer_sleep_done, (void *)&done);
+    // done is checked with interrupts disabled, so the wakeup cannot slip
+    // in between the check and the halt.
+    while (!done) {
+        idle_wait();
+    }
+    cpu_irq_restore(flags);
+}
+
+void timer_sleep(uint64_t us) {
+    timer_sleep_until(timer_now() + timer_us_to_cycles(us));
+}
+
+void timer_set_tick(uint32_t hz, pit_callback tick) {
+    uint32_t flags = cpu_irq_save();
+    timer_tick = tick;
+    timer_tick_hz = hz;
+    if (hz) {
+        pit_set_frequency(hz);
+    } else {
+        timer_program();
+    }
+    cpu_irq_restore(flags);
+}
@@ -0,0 +1,63 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+#include "../drivers/pit/pit.h"
+
+// The TSC is calibrated against this many ticks of the PIT at this rate.
+#define TIMER_CALIBRATE_HZ 1000
+#define TIMER_CALIBRATE_TICKS 50
+
+// One-shot countdowns are kept within what channel 0 can count, about 55ms,
+// and above what it can be programmed in, so a deadline is never missed.
+#define TIMER_PIT_MAX_COUNT 0xFFFF
+#define TIMER_PIT_MIN_COUNT 16
+
+// Called from the timer interrupt once the deadline has passed.
+typedef void (*timer_fn)(void *ctx);
+
+typedef struct timer {
+    // TSC value after which the timer fires.
+    uint64_t deadline;
+    timer_fn fn;
+    void *ctx;
+    int pending;
+    struct timer *next;
+} timer;
+
+// Calibrate the TSC against the PIT and switch the PIT to one-shot mode, it
+// then only interrupts for the earliest pending timer. pit_init must have
+// run and interrupts must be enabled.
+int timer_init();
+
+// Current time, in TSC cycles.
+uint64_t timer_now();
+
+// TSC frequency in kHz.
+uint32_t timer_tsc_khz();
+
+// Convert a duration in microseconds to TSC cycles.
+uint64_t timer_us_to_cycles(uint64_t us);
+
+// Arm `t` to call `fn(ctx)` from the timer interrupt once timer_now passes
+// `deadline`. Re-adding a pending timer moves it.
+void timer_add(timer *t, uint64_t deadline, timer_fn fn, void *ctx);
+
+// Disarm `t` if it is pending.
+void timer_cancel(timer *t);
+
+// Wait until timer_now passes `deadline`. With interrupts enabled the CPU
+// idles until the timer interrupt, called with them disabled (e.g. from a
+// system call) it spins on the TSC and leaves them disabled.
+void timer_sleep_until(uint64_t deadline);
+
+// timer_sleep_until `us` microseconds from now.
+void timer_sleep(uint64_t us);
+
+// Switch the PIT to a periodic tick of `hz`, calling `tick` with the
+// interrupted frame on every tick, for the profiler. Timers then fire on the
+// first tick after their deadline. A rate of 0 returns to one-shot mode.
+void timer_set_tick(uint32_t hz, pit_callback tick);
+
+#endif  // TIMER_H